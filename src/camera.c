@@ -35,6 +35,7 @@
 # include <linux/videodev2.h>
 #endif
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -48,6 +49,10 @@
 #include <gdk/gdkkeysyms.h>
 #include <System.h>
 #include <Desktop.h>
+#include "convert.h"
+#include "decode.h"
+#include "pool.h"
+#include "source.h"
 #include "camera.h"
 #include "../config.h"
 #define _(string) gettext(string)
@@ -66,8 +71,20 @@
 #ifndef BINDIR
 # define BINDIR			PREFIX "/bin"
 #endif
+#define CAMERA_BUFFERS		4
+/* one rendered, one waiting and one queued at least */
+#define CAMERA_BUFFERS_MIN	3
+#define CAMERA_BUFFERS_MAX	32
+#define CAMERA_READ_BUFFERS	3
+/* frames observed before adapting the number of buffers */
+#define CAMERA_ADAPT_FRAMES	120
+/* periods without any drop before releasing a buffer */
+#define CAMERA_ADAPT_PERIODS	10
 
 /* macros */
+#ifndef MAX
+# define MAX(a, b)	((a) > (b) ? (a) : (b))
+#endif
 #ifndef MIN
 # define MIN(a, b)	((a) < (b) ? (a) : (b))
 #endif
@@ -76,12 +93,37 @@
 /* Camera */
 /* private */
 /* types */
+/* one per plane of memory */
 typedef struct _CameraBuffer
 {
 	void * start;
 	size_t length;
+	/* the data captured */
+	size_t offset;
+	size_t used;
+	/* exported as a DMABUF, or -1 */
+	int fd;
+	/* consumers of the frame exported, in the first plane */
+	unsigned int refs;
 } CameraBuffer;
 
+typedef struct _CameraMode
+{
+	uint32_t pixelformat;
+	unsigned int cost;
+	uint32_t width;
+	uint32_t height;
+	/* 0/0 when unknown */
+	struct v4l2_fract interval;
+} CameraMode;
+
+typedef enum _CameraPolicy
+{
+	CP_FPS = 0,
+	CP_RESOLUTION,
+	CP_SIZE
+} CameraPolicy;
+
 struct _Camera
 {
 	String * device;
@@ -91,29 +133,110 @@ struct _Camera
 	GdkInterpType interp;
 	CameraSnapshotFormat snapshot_format;
 	int snapshot_quality;
+	/* choice of the capture format */
+	CameraPolicy policy;
+	uint32_t policy_width;
+	uint32_t policy_height;
+	CameraMode mode;
+	gboolean mode_valid;
+	/* render the most recent frame only */
+	gboolean lowlatency;
+	/* maximum number of frames waiting to be rendered (0 for automatic) */
+	int queue;
+	/* number of buffers to request (0 for the default) */
+	int reqbufs;
+	/* adapt the number of buffers to the frames dropped */
+	gboolean adaptive;
+	size_t adaptive_cnt;
+	unsigned int adaptive_periods;
+	unsigned long adaptive_frames;
+	unsigned long adaptive_dropped;
+	/* capture into memory of our own */
+	gboolean userptr;
+	gboolean hugepages;
+	/* share the buffers captured with other consumers */
+	gboolean export;
+	/* frames per second (0 for the default) */
+	unsigned int framerate;
+	/* frames per second while in the background (0 for the same) */
+	unsigned int idlerate;
+	gboolean unfocused;
+	/* iconified or withdrawn */
+	gboolean iconified;
+	/* the frames are converted only while they can be seen */
+	gboolean mapped;
+	/* only known without any compositing */
+	gboolean obscured;
+	gboolean visible;
+	/* frames dropped when the device cannot slow down (microseconds) */
+	gint64 interval;
+	gint64 due;
+	/* the interval last requested from the device */
+	struct v4l2_fract timeperframe;
 
 	guint source;
 	int fd;
-	struct v4l2_buffer buf;
+	/* the input signal may change or end */
+	gboolean events;
+	guint change;
+	/* the change is followed once the frames exported are released */
+	gboolean renegotiate;
+	/* when not capturing from a device */
+	CameraSource * input;
+	/* play recorded sessions at the original pace */
+	gboolean realtime;
 	struct v4l2_capability cap;
+	/* single-planar or multi-planar */
+	enum v4l2_buf_type type;
 	struct v4l2_format format;
-
-	/* I/O channel */
-	GIOChannel * channel;
+	/* the current format, seen as single-planar */
+	struct v4l2_pix_format pix;
+	size_t planes_cnt;
+
+	/* capture thread */
+	GThread * thread;
+	GMutex mutex;
+	gboolean running;
+	int wakeup[2];
+	guint refresh;
+#if GTK_CHECK_VERSION(3, 8, 0)
+	/* rendering in time for the frame clock */
+	guint tick;
+#endif
+	char * error;
+	/* frames captured and waiting to be rendered (oldest first) */
+	size_t * ready;
+	size_t ready_cnt;
+	size_t ready_max;
+	/* frames rendered or dropped, to be queued again */
+	size_t * done;
+	size_t done_cnt;
+	/* frames rendered but still exported */
+	size_t held_cnt;
+	/* frames captured and lost by the device since started */
+	unsigned long frames;
+	unsigned long dropped;
+	uint32_t sequence;
 
 	/* input data */
-	/* XXX for mmap() */
+	gboolean streaming;
+	enum v4l2_memory memory;
+	/* the planes of every buffer, one after the other */
 	CameraBuffer * buffers;
 	size_t buffers_cnt;
-	char * raw_buffer;
-	size_t raw_buffer_cnt;
+	/* changes every time the buffers are freed, for the exports */
+	unsigned int generation;
+	/* last frame rendered, held until the next one for snapshots */
+	CameraBuffer * raw_buffer;
+	size_t raw_index;
 
 	/* RGB data */
-	unsigned char * rgb_buffer;
-	size_t rgb_buffer_cnt;
+	CameraPool * pool;
 
 	/* decoding */
-	int yuv_amp;
+	CameraConvert * convert;
+	int threads;
+	CameraDecode * decode;
 
 	/* overlays */
 	CameraOverlay ** overlays;
@@ -134,7 +257,13 @@ struct _Camera
 #endif
 	GtkWidget * area;
 	GtkAllocation area_allocation;
+	/* where the frames are drawn, the borders are left black */
+	GdkRectangle letterbox;
 	GdkPixbuf * pixbuf;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	/* frames converted for cairo */
+	cairo_surface_t * frame;
+#endif
 #if !GTK_CHECK_VERSION(3, 0, 0)
 	GdkPixmap * pixmap;
 #endif
@@ -145,6 +274,8 @@ struct _Camera
 	GtkWidget * pr_ratio;
 	GtkWidget * pr_interp;
 	GtkWidget * pr_sformat;
+	GtkWidget * pr_framerate;
+	GtkWidget * pr_idlerate;
 	/* properties */
 	GtkWidget * pp_window;
 };
@@ -178,18 +309,45 @@ typedef enum _CameraToolbar
 static String * _camera_get_config_filename(Camera * camera, char const * name);
 
 /* useful */
+static void _camera_apply_drop(Camera * camera,
+		struct v4l2_fract const * interval);
+static void _camera_apply_idle(Camera * camera);
+static void _camera_apply_rate(Camera * camera);
+
+static int _camera_convert(Camera * camera, CameraConvertFormat format,
+		unsigned int shrink, unsigned char * dst, size_t dst_stride);
+static unsigned int _camera_convert_cost(uint32_t pixelformat);
+
 static int _camera_error(Camera * camera, char const * message, int ret);
+static size_t _camera_exported(Camera * camera);
 
 static int _camera_ioctl(Camera * camera, unsigned long request,
 		void * data);
 
+static void _camera_letterbox(Camera * camera, GdkRectangle * rect);
+
+static unsigned int _camera_planes(Camera * camera,
+		CameraConvertPlane planes[CAMERACONVERT_PLANES_MAX]);
+
+static void _camera_free_buffers(Camera * camera);
+
+static int _camera_set_mode(Camera * camera, CameraMode const * mode);
+static void _camera_set_rate(Camera * camera);
+static void _camera_set_visible(Camera * camera);
+
+static int _camera_start_buffers(Camera * camera);
+static void _camera_stop_buffers(Camera * camera);
+static void _camera_stop_capture(Camera * camera);
+
 /* callbacks */
-static gboolean _camera_on_can_mmap(GIOChannel * channel,
-		GIOCondition condition, gpointer data);
-static gboolean _camera_on_can_read(GIOChannel * channel,
-		GIOCondition condition, gpointer data);
+static gpointer _camera_capture(gpointer data);
 static gboolean _camera_on_drawing_area_configure(GtkWidget * widget,
 		GdkEventConfigure * event, gpointer data);
+static void _camera_on_drawing_area_map(GtkWidget * widget, gpointer data);
+#if !GTK_CHECK_VERSION(3, 0, 0)
+static gboolean _camera_on_drawing_area_visibility(GtkWidget * widget,
+		GdkEventVisibility * event, gpointer data);
+#endif
 #if GTK_CHECK_VERSION(3, 0, 0)
 static gboolean _camera_on_drawing_area_draw(GtkWidget * widget, cairo_t * cr,
 		gpointer data);
@@ -199,6 +357,9 @@ static void _camera_on_drawing_area_size_allocate(GtkWidget * widget,
 static gboolean _camera_on_drawing_area_expose(GtkWidget * widget,
 		GdkEventExpose * event, gpointer data);
 #endif
+static gboolean _camera_on_focus(GtkWidget * widget, GdkEventFocus * event,
+		gpointer data);
+static gboolean _camera_on_change(gpointer data);
 static void _camera_on_fullscreen(gpointer data);
 static void _camera_on_gallery(gpointer data);
 static gboolean _camera_on_open(gpointer data);
@@ -208,6 +369,12 @@ static void _camera_on_preferences(gpointer data);
 static void _camera_on_properties(gpointer data);
 static gboolean _camera_on_refresh(gpointer data);
 static void _camera_on_snapshot(gpointer data);
+#if GTK_CHECK_VERSION(3, 8, 0)
+static gboolean _camera_on_tick(GtkWidget * widget, GdkFrameClock * clock,
+		gpointer data);
+#endif
+static gboolean _camera_on_window_state(GtkWidget * widget,
+		GdkEventWindowState * event, gpointer data);
 
 
 /* variables */
@@ -254,19 +421,75 @@ Camera * camera_new(GtkWidget * window, GtkAccelGroup * group,
 	camera->vflip = FALSE;
 	camera->ratio = TRUE;
 	camera->interp = GDK_INTERP_BILINEAR;
+	camera->policy = CP_FPS;
+	camera->policy_width = 0;
+	camera->policy_height = 0;
+	camera->mode_valid = FALSE;
 	camera->snapshot_format = CSF_PNG;
 	camera->snapshot_quality = 100;
 	camera->source = 0;
 	camera->fd = -1;
+	camera->events = FALSE;
+	camera->change = 0;
+	camera->renegotiate = FALSE;
+	camera->input = NULL;
 	memset(&camera->cap, 0, sizeof(camera->cap));
-	camera->channel = NULL;
+	camera->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	memset(&camera->pix, 0, sizeof(camera->pix));
+	camera->planes_cnt = 1;
+	camera->thread = NULL;
+	g_mutex_init(&camera->mutex);
+	camera->running = FALSE;
+	camera->wakeup[0] = -1;
+	camera->wakeup[1] = -1;
+	camera->refresh = 0;
+#if GTK_CHECK_VERSION(3, 8, 0)
+	camera->tick = 0;
+#endif
+	camera->error = NULL;
+	camera->ready = NULL;
+	camera->ready_cnt = 0;
+	camera->ready_max = 0;
+	camera->done = NULL;
+	camera->done_cnt = 0;
+	camera->held_cnt = 0;
+	camera->streaming = FALSE;
+	camera->memory = V4L2_MEMORY_MMAP;
 	camera->buffers = NULL;
 	camera->buffers_cnt = 0;
+	camera->generation = 0;
 	camera->raw_buffer = NULL;
-	camera->raw_buffer_cnt = 0;
-	camera->rgb_buffer = NULL;
-	camera->rgb_buffer_cnt = 0;
-	camera->yuv_amp = 255;
+	camera->raw_index = 0;
+	camera->pool = camerapool_new();
+	camera->convert = cameraconvert_new(255);
+	camera->decode = cameradecode_new();
+	camera->threads = 0;
+	camera->lowlatency = FALSE;
+	camera->queue = 0;
+	camera->reqbufs = 0;
+	camera->adaptive = FALSE;
+	camera->adaptive_cnt = 0;
+	camera->userptr = FALSE;
+	camera->hugepages = FALSE;
+	camera->export = FALSE;
+	camera->realtime = TRUE;
+	camera->framerate = 0;
+	camera->idlerate = 0;
+	camera->unfocused = FALSE;
+	camera->iconified = FALSE;
+	camera->mapped = FALSE;
+	camera->obscured = FALSE;
+	camera->visible = FALSE;
+	camera->interval = 0;
+	camera->due = 0;
+	camera->timeperframe.numerator = 0;
+	camera->timeperframe.denominator = 0;
+	camera->adaptive_periods = 0;
+	camera->adaptive_frames = 0;
+	camera->adaptive_dropped = 0;
+	camera->frames = 0;
+	camera->dropped = 0;
+	camera->sequence = 0;
 	camera->overlays = NULL;
 	camera->overlays_cnt = 0;
 	camera->widget = NULL;
@@ -276,11 +499,22 @@ Camera * camera_new(GtkWidget * window, GtkAccelGroup * group,
 	camera->surface = NULL;
 #else
 	camera->gc = NULL;
+#endif
+	camera->area = NULL;
+	memset(&camera->letterbox, 0, sizeof(camera->letterbox));
+	camera->pixbuf = NULL;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	camera->frame = NULL;
+#else
+	camera->pixmap = NULL;
 #endif
 	camera->pr_window = NULL;
 	camera->pp_window = NULL;
 	/* check for errors */
-	if(camera->device == NULL)
+	if(camera->device == NULL || camera->pool == NULL
+			|| camera->convert == NULL || camera->decode == NULL
+			|| cameraconvert_set_bands(camera->convert,
+				camera->threads) != 0)
 	{
 		camera_delete(camera);
 		return NULL;
@@ -329,12 +563,12 @@ Camera * camera_new(GtkWidget * window, GtkAccelGroup * group,
 	gtk_box_pack_start(GTK_BOX(vbox), camera->infobar, FALSE, TRUE, 0);
 #endif
 	camera->area = gtk_drawing_area_new();
-	camera->pixbuf = NULL;
-#if !GTK_CHECK_VERSION(3, 0, 0)
-	camera->pixmap = NULL;
-#endif
 	g_signal_connect(camera->area, "configure-event", G_CALLBACK(
 				_camera_on_drawing_area_configure), camera);
+	g_signal_connect(camera->area, "map", G_CALLBACK(
+				_camera_on_drawing_area_map), camera);
+	g_signal_connect(camera->area, "unmap", G_CALLBACK(
+				_camera_on_drawing_area_map), camera);
 #if GTK_CHECK_VERSION(3, 0, 0)
 	g_signal_connect(camera->area, "draw", G_CALLBACK(
 				_camera_on_drawing_area_draw), camera);
@@ -343,9 +577,20 @@ Camera * camera_new(GtkWidget * window, GtkAccelGroup * group,
 #else
 	g_signal_connect(camera->area, "expose-event", G_CALLBACK(
 				_camera_on_drawing_area_expose), camera);
+	/* never reported once composited */
+	gtk_widget_add_events(camera->area, GDK_VISIBILITY_NOTIFY_MASK);
+	g_signal_connect(camera->area, "visibility-notify-event", G_CALLBACK(
+				_camera_on_drawing_area_visibility), camera);
 #endif
 	gtk_box_pack_start(GTK_BOX(vbox), camera->area, TRUE, TRUE, 0);
 	gtk_widget_show_all(vbox);
+	/* track when the window is in the background */
+	g_signal_connect(window, "focus-in-event", G_CALLBACK(
+				_camera_on_focus), camera);
+	g_signal_connect(window, "focus-out-event", G_CALLBACK(
+				_camera_on_focus), camera);
+	g_signal_connect(window, "window-state-event", G_CALLBACK(
+				_camera_on_window_state), camera);
 	camera_start(camera);
 	return camera;
 }
@@ -354,9 +599,19 @@ Camera * camera_new(GtkWidget * window, GtkAccelGroup * group,
 /* camera_delete */
 void camera_delete(Camera * camera)
 {
+	if(camera->window != NULL)
+		g_signal_handlers_disconnect_matched(camera->window,
+				G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, camera);
 	camera_stop(camera);
 	if(camera->bold != NULL)
 		pango_font_description_free(camera->bold);
+	g_mutex_clear(&camera->mutex);
+	if(camera->convert != NULL)
+		cameraconvert_delete(camera->convert);
+	if(camera->decode != NULL)
+		cameradecode_delete(camera->decode);
+	if(camera->pool != NULL)
+		camerapool_delete(camera->pool);
 	string_delete(camera->device);
 	object_delete(camera);
 }
@@ -394,11 +649,21 @@ int camera_set_device(Camera * camera, char const * device)
 	camera_stop(camera);
 	string_delete(camera->device);
 	camera->device = p;
+	camera->adaptive_cnt = 0;
+	camera->mode_valid = FALSE;
 	camera_start(camera);
 	return 0;
 }
 
 
+/* camera_set_framerate */
+void camera_set_framerate(Camera * camera, unsigned int framerate)
+{
+	camera->framerate = framerate;
+	_camera_set_rate(camera);
+}
+
+
 /* camera_set_hflip */
 void camera_set_hflip(Camera * camera, gboolean flip)
 {
@@ -431,7 +696,97 @@ CameraOverlay * camera_add_overlay(Camera * camera, char const * filename,
 }
 
 
+/* camera_export_acquire */
+int camera_export_acquire(Camera * camera, CameraExport * export)
+{
+	CameraBuffer * buffer;
+	size_t i;
+
+	g_mutex_lock(&camera->mutex);
+	if((buffer = camera->raw_buffer) == NULL || buffer->fd < 0
+			|| camera->planes_cnt > CAMERA_EXPORT_PLANES_MAX)
+	{
+		g_mutex_unlock(&camera->mutex);
+		return -error_set_code(1, "%s: %s", camera->device,
+				_("No frame to export"));
+	}
+	/* keep enough buffers for capturing and rendering */
+	if(buffer->refs == 0 && camera->held_cnt + 1 + camera->ready_max
+			>= camera->buffers_cnt)
+	{
+		g_mutex_unlock(&camera->mutex);
+		return -error_set_code(1, "%s: %s", camera->device,
+				_("Too many frames exported"));
+	}
+	buffer->refs++;
+	export->index = camera->raw_index;
+	export->generation = camera->generation;
+	export->fourcc = camera->pix.pixelformat;
+	export->width = camera->pix.width;
+	export->height = camera->pix.height;
+	export->planes_cnt = camera->planes_cnt;
+	for(i = 0; i < camera->planes_cnt; i++)
+	{
+		export->planes[i].fd = buffer[i].fd;
+		export->planes[i].offset = buffer[i].offset;
+		export->planes[i].size = buffer[i].used;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+		if(camera->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+			export->planes[i].stride = camera->format.fmt.pix_mp
+				.plane_fmt[i].bytesperline;
+		else
+#endif
+			export->planes[i].stride = camera->pix.bytesperline;
+	}
+	g_mutex_unlock(&camera->mutex);
+	return 0;
+}
+
+
+/* camera_export_release */
+void camera_export_release(Camera * camera, CameraExport const * export)
+{
+	CameraBuffer * buffer;
+	gboolean wakeup = FALSE;
+	size_t i;
+
+	g_mutex_lock(&camera->mutex);
+	if(export->generation != camera->generation
+			|| export->index >= camera->buffers_cnt)
+	{
+		/* the buffers were freed meanwhile */
+		g_mutex_unlock(&camera->mutex);
+		return;
+	}
+	buffer = &camera->buffers[export->index * camera->planes_cnt];
+	if(buffer->refs > 0 && --buffer->refs == 0
+			&& buffer != camera->raw_buffer)
+	{
+		/* the frame was rendered already */
+		camera->held_cnt--;
+		camera->done[camera->done_cnt++] = export->index;
+		wakeup = TRUE;
+	}
+	if(camera->renegotiate && buffer->refs == 0)
+	{
+		/* follow the input signal once every frame is released */
+		for(i = 0; i < camera->buffers_cnt; i++)
+			if(camera->buffers[i * camera->planes_cnt].refs > 0)
+				break;
+		if(i == camera->buffers_cnt && camera->change == 0)
+			camera->change = g_idle_add(_camera_on_change, camera);
+	}
+	g_mutex_unlock(&camera->mutex);
+	/* the capture may have stopped meanwhile */
+	if(wakeup && camera->wakeup[1] >= 0
+			&& write(camera->wakeup[1], "", 1) != 1
+			&& errno != EAGAIN)
+		_camera_error(NULL, strerror(errno), 1);
+}
+
+
 /* camera_load */
+static void _load_policy(Camera * camera, char const * policy);
 char const * _load_variable(Camera * camera, Config * config,
 		char const * section, char const * variable);
 
@@ -481,6 +836,77 @@ int camera_load(Camera * camera)
 				&& p[0] != '\0' && (i = strtol(p, &q, 10)) >= 0
 				&& *q == '\0' && i <= 100)
 			camera->snapshot_quality = i;
+		/* conversion threads (0 for one per processor) */
+		camera->threads = 0;
+		if((p = _load_variable(camera, config, NULL, "threads")) != NULL
+				&& p[0] != '\0' && (i = strtol(p, &q, 10)) >= 0
+				&& *q == '\0')
+			camera->threads = i;
+		if(cameraconvert_set_bands(camera->convert, camera->threads)
+				!= 0)
+			_camera_error(camera, error_get(NULL), 1);
+		/* low latency */
+		camera->lowlatency = FALSE;
+		if((p = _load_variable(camera, config, NULL, "lowlatency"))
+				!= NULL && strtoul(p, NULL, 0) != 0)
+			camera->lowlatency = TRUE;
+		/* frames waiting to be rendered (0 for automatic) */
+		camera->queue = 0;
+		if((p = _load_variable(camera, config, NULL, "queue")) != NULL
+				&& p[0] != '\0' && (i = strtol(p, &q, 10)) >= 0
+				&& *q == '\0')
+			camera->queue = i;
+		/* number of buffers (0 for the default) */
+		camera->reqbufs = 0;
+		if((p = _load_variable(camera, config, NULL, "buffers"))
+				!= NULL && p[0] != '\0'
+				&& (i = strtol(p, &q, 10)) >= 0 && *q == '\0')
+			camera->reqbufs = MIN(i, CAMERA_BUFFERS_MAX);
+		/* adaptive number of buffers */
+		camera->adaptive = FALSE;
+		if((p = _load_variable(camera, config, NULL, "adaptive"))
+				!= NULL && strtoul(p, NULL, 0) != 0)
+			camera->adaptive = TRUE;
+		camera->adaptive_cnt = 0;
+		/* capture into memory of our own */
+		camera->userptr = FALSE;
+		if((p = _load_variable(camera, config, NULL, "userptr"))
+				!= NULL && strtoul(p, NULL, 0) != 0)
+			camera->userptr = TRUE;
+		camera->hugepages = FALSE;
+		if((p = _load_variable(camera, config, NULL, "hugepages"))
+				!= NULL && strtoul(p, NULL, 0) != 0)
+			camera->hugepages = TRUE;
+		/* share the buffers captured */
+		camera->export = FALSE;
+		if((p = _load_variable(camera, config, NULL, "export"))
+				!= NULL && strtoul(p, NULL, 0) != 0)
+			camera->export = TRUE;
+		/* as fast as possible otherwise */
+		camera->realtime = TRUE;
+		if((p = _load_variable(camera, config, NULL, "realtime"))
+				!= NULL && strtoul(p, NULL, 0) == 0)
+			camera->realtime = FALSE;
+		/* frame rate (0 for the default) */
+		camera->framerate = 0;
+		if((p = _load_variable(camera, config, NULL, "framerate"))
+				!= NULL && p[0] != '\0'
+				&& (i = strtol(p, &q, 10)) >= 0 && i <= 240
+				&& *q == '\0')
+			camera->framerate = i;
+		camera->idlerate = 0;
+		if((p = _load_variable(camera, config, NULL, "idlerate"))
+				!= NULL && p[0] != '\0'
+				&& (i = strtol(p, &q, 10)) >= 0 && i <= 240
+				&& *q == '\0')
+			camera->idlerate = i;
+		_camera_set_rate(camera);
+		/* choice of the capture format */
+		camera->policy = CP_FPS;
+		if((p = _load_variable(camera, config, NULL, "policy"))
+				!= NULL)
+			_load_policy(camera, p);
+		camera->mode_valid = FALSE;
 		/* FIXME also implement interpolation and overlay images */
 	}
 	if(config != NULL)
@@ -489,6 +915,30 @@ int camera_load(Camera * camera)
 	return ret;
 }
 
+static void _load_policy(Camera * camera, char const * policy)
+{
+	unsigned long width;
+	unsigned long height;
+	char * p;
+
+	if(strcmp(policy, "resolution") == 0)
+		camera->policy = CP_RESOLUTION;
+	else if(policy[0] >= '1' && policy[0] <= '9'
+			&& (width = strtoul(policy, &p, 10)) > 0
+			&& *p == 'x' && p[1] >= '1' && p[1] <= '9'
+			&& (height = strtoul(&p[1], &p, 10)) > 0
+			&& *p == '\0' && width <= UINT32_MAX
+			&& height <= UINT32_MAX)
+	{
+		/* closest to a given size */
+		camera->policy = CP_SIZE;
+		camera->policy_width = width;
+		camera->policy_height = height;
+	}
+	else
+		camera->policy = CP_FPS;
+}
+
 char const * _load_variable(Camera * camera, Config * config,
 		char const * section, char const * variable)
 {
@@ -534,6 +984,7 @@ int camera_save(Camera * camera)
 	char * filename;
 	Config * config;
 	char const * sformats[CSF_COUNT] = { NULL, "png", "jpeg" };
+	char policy[24];
 
 	if((filename = _camera_get_config_filename(camera, CAMERA_CONFIG_FILE))
 			== NULL)
@@ -553,6 +1004,37 @@ int camera_save(Camera * camera)
 				sformats[camera->snapshot_format]);
 		_save_variable_int(camera, config, "snapshot", "quality",
 				camera->snapshot_quality);
+		_save_variable_int(camera, config, NULL, "threads",
+				camera->threads);
+		_save_variable_bool(camera, config, NULL, "lowlatency",
+				camera->lowlatency);
+		_save_variable_int(camera, config, NULL, "queue",
+				camera->queue);
+		_save_variable_int(camera, config, NULL, "buffers",
+				camera->reqbufs);
+		_save_variable_bool(camera, config, NULL, "adaptive",
+				camera->adaptive);
+		_save_variable_bool(camera, config, NULL, "userptr",
+				camera->userptr);
+		_save_variable_bool(camera, config, NULL, "hugepages",
+				camera->hugepages);
+		_save_variable_bool(camera, config, NULL, "export",
+				camera->export);
+		_save_variable_bool(camera, config, NULL, "realtime",
+				camera->realtime);
+		_save_variable_int(camera, config, NULL, "framerate",
+				camera->framerate);
+		_save_variable_int(camera, config, NULL, "idlerate",
+				camera->idlerate);
+		if(camera->policy == CP_SIZE)
+			snprintf(policy, sizeof(policy), "%ux%u",
+					camera->policy_width,
+					camera->policy_height);
+		else
+			snprintf(policy, sizeof(policy), "%s",
+					(camera->policy == CP_RESOLUTION)
+					? "resolution" : "fps");
+		_save_variable_string(camera, config, NULL, "policy", policy);
 		/* FIXME also implement interpolation and overlay images */
 		ret = config_save(config, filename);
 	}
@@ -638,6 +1120,11 @@ static void _preferences_apply(Camera * camera)
 		gtk_tree_model_get(model, &iter, 0, &camera->snapshot_format,
 				-1);
 	}
+	/* frame rate */
+	camera->idlerate = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(
+				camera->pr_idlerate));
+	camera_set_framerate(camera, gtk_spin_button_get_value_as_int(
+				GTK_SPIN_BUTTON(camera->pr_framerate)));
 }
 
 static void _preferences_cancel(Camera * camera)
@@ -682,6 +1169,11 @@ static void _preferences_cancel(Camera * camera)
 				&iter);
 	else
 		gtk_combo_box_set_active(GTK_COMBO_BOX(camera->pr_sformat), 0);
+	/* frame rate */
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(camera->pr_framerate),
+			camera->framerate);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(camera->pr_idlerate),
+			camera->idlerate);
 }
 
 static void _preferences_save(Camera * camera)
@@ -787,6 +1279,29 @@ static void _preferences_window(Camera * camera)
 	gtk_box_pack_start(GTK_BOX(vbox), widget, FALSE, TRUE, 0);
 	gtk_notebook_append_page(GTK_NOTEBOOK(notebook), vbox,
 			gtk_label_new(_("Snapshots")));
+	/* capture */
+	vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
+	gtk_container_set_border_width(GTK_CONTAINER(vbox), 4);
+	/* frame rate */
+	widget = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+	gtk_box_pack_start(GTK_BOX(widget), gtk_label_new(
+				_("Frames per second (0 for the default): ")),
+			FALSE, TRUE, 0);
+	camera->pr_framerate = gtk_spin_button_new_with_range(0.0, 240.0, 1.0);
+	gtk_box_pack_start(GTK_BOX(widget), camera->pr_framerate, FALSE, TRUE,
+			0);
+	gtk_box_pack_start(GTK_BOX(vbox), widget, FALSE, TRUE, 0);
+	/* in the background */
+	widget = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+	gtk_box_pack_start(GTK_BOX(widget), gtk_label_new(
+				_("In the background (0 for the same): ")),
+			FALSE, TRUE, 0);
+	camera->pr_idlerate = gtk_spin_button_new_with_range(0.0, 240.0, 1.0);
+	gtk_box_pack_start(GTK_BOX(widget), camera->pr_idlerate, FALSE, TRUE,
+			0);
+	gtk_box_pack_start(GTK_BOX(vbox), widget, FALSE, TRUE, 0);
+	gtk_notebook_append_page(GTK_NOTEBOOK(notebook), vbox,
+			gtk_label_new(_("Capture")));
 	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
 	gtk_box_set_spacing(GTK_BOX(vbox), 4);
 	gtk_box_pack_start(GTK_BOX(vbox), notebook, TRUE, TRUE, 0);
@@ -830,7 +1345,7 @@ static void _properties_on_response(gpointer data);
 
 void camera_show_properties(Camera * camera, gboolean show)
 {
-	if(camera->rgb_buffer == NULL)
+	if(camera->buffers == NULL)
 		/* ignore the action */
 		return;
 	if(show)
@@ -887,6 +1402,9 @@ static void _properties_window(Camera * camera)
 	} capabilities[] =
 	{
 		{ V4L2_CAP_VIDEO_CAPTURE,	"video capture"	},
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+		{ V4L2_CAP_VIDEO_CAPTURE_MPLANE, "multi-planar capture" },
+#endif
 #ifdef V4L2_CAP_VIDEO_OUTPUT
 		{ V4L2_CAP_VIDEO_OUTPUT,	"video output"	},
 #endif
@@ -1006,7 +1524,7 @@ int camera_snapshot(Camera * camera, CameraSnapshotFormat format)
 	char const * e;
 	char * path;
 
-	if(camera->rgb_buffer == NULL)
+	if(camera->raw_buffer == NULL)
 		/* ignore the action */
 		return 0;
 	if(format == CSF_DEFAULT)
@@ -1098,17 +1616,22 @@ static char * _snapshot_path(Camera * camera, char const * homedir,
 static int _snapshot_save(Camera * camera, char const * path,
 		CameraSnapshotFormat format)
 {
-	struct v4l2_pix_format * pix = &camera->format.fmt.pix;
+	struct v4l2_pix_format * pix = &camera->pix;
 	GdkPixbuf * pixbuf;
 	char buf[16];
 	gboolean res;
 	GError * error = NULL;
 
-	if((pixbuf = gdk_pixbuf_new_from_data(camera->rgb_buffer,
-					GDK_COLORSPACE_RGB, FALSE, 8,
-					pix->width, pix->height, pix->width * 3,
-					NULL, NULL)) == NULL)
+	/* the frame rendered may have been scaled */
+	if((pixbuf = camerapool_get(camera->pool, pix->width, pix->height,
+					FALSE)) == NULL)
+		return -_camera_error(camera, _("Could not save picture"), 1);
+	if(_camera_convert(camera, CCF_RGB24, 1, gdk_pixbuf_get_pixels(pixbuf),
+				gdk_pixbuf_get_rowstride(pixbuf)) != 0)
+	{
+		camerapool_put(camera->pool, pixbuf);
 		return -_camera_error(camera, _("Could not save picture"), 1);
+	}
 	switch(format)
 	{
 		case CSF_JPEG:
@@ -1125,7 +1648,7 @@ static int _snapshot_save(Camera * camera, char const * path,
 			res = FALSE;
 			break;
 	}
-	g_object_unref(pixbuf);
+	camerapool_put(camera->pool, pixbuf);
 	if(res != TRUE)
 	{
 		error_set_code(1, "%s: %s", _("Could not save picture"),
@@ -1141,7 +1664,7 @@ static int _snapshot_save(Camera * camera, char const * path,
 /* camera_start */
 void camera_start(Camera * camera)
 {
-	if(camera->source != 0)
+	if(camera->source != 0 || camera->thread != NULL)
 		return;
 	camera->source = g_idle_add(_camera_on_open, camera);
 }
@@ -1155,6 +1678,12 @@ void camera_stop(Camera * camera)
 	if(camera->source != 0)
 		g_source_remove(camera->source);
 	camera->source = 0;
+	/* the restarts in place follow the input signal still */
+	if(camera->change != 0)
+		g_source_remove(camera->change);
+	camera->change = 0;
+	camera->renegotiate = FALSE;
+	_camera_stop_capture(camera);
 	if(camera->pp_window != NULL)
 		gtk_widget_destroy(camera->pp_window);
 	camera->pp_window = NULL;
@@ -1166,17 +1695,15 @@ void camera_stop(Camera * camera)
 	free(camera->overlays);
 	camera->overlays = NULL;
 	camera->overlays_cnt = 0;
-	if(camera->channel != NULL)
-	{
-		/* XXX we ignore errors at this point */
-		g_io_channel_shutdown(camera->channel, TRUE, NULL);
-		g_io_channel_unref(camera->channel);
-	}
-	camera->channel = NULL;
 	if(camera->pixbuf != NULL)
 		g_object_unref(camera->pixbuf);
 	camera->pixbuf = NULL;
+	if(camera->pool != NULL)
+		camerapool_flush(camera->pool);
 #if GTK_CHECK_VERSION(3, 0, 0)
+	if(camera->frame != NULL)
+		cairo_surface_destroy(camera->frame);
+	camera->frame = NULL;
 	if(camera->surface != NULL)
 		cairo_surface_destroy(camera->surface);
 	camera->surface = NULL;
@@ -1188,23 +1715,48 @@ void camera_stop(Camera * camera)
 		g_object_unref(camera->gc);
 	camera->gc = NULL;
 #endif
-	if((char *)camera->rgb_buffer != camera->raw_buffer)
-		free(camera->rgb_buffer);
-	camera->rgb_buffer = NULL;
-	if(camera->buffers_cnt > 0)
+	_camera_free_buffers(camera);
+	if(camera->input != NULL)
+		camerasource_delete(camera->input);
+	camera->input = NULL;
+	if(camera->fd >= 0)
+		close(camera->fd);
+	camera->fd = -1;
+	camera->events = FALSE;
+}
+
+
+/* camera_reconfigure */
+int camera_reconfigure(Camera * camera, unsigned int pixelformat,
+		unsigned int width, unsigned int height)
+{
+	CameraMode mode;
+
+	memset(&mode, 0, sizeof(mode));
+	mode.pixelformat = (pixelformat != 0) ? pixelformat
+		: camera->pix.pixelformat;
+	mode.width = (width != 0) ? width : camera->pix.width;
+	mode.height = (height != 0) ? height : camera->pix.height;
+	if(camera->mode_valid)
+		mode.interval = camera->mode.interval;
+	if((mode.cost = _camera_convert_cost(mode.pixelformat)) == 0)
+		return -error_set_code(1, "%s: %s", camera->device,
+				_("Unsupported format"));
+	if(camera->input != NULL)
+		return -error_set_code(1, "%s: %s", camera->device,
+				_("The format of this source cannot be changed"));
+	if(camera->fd < 0)
 	{
-		for(i = 0; i < camera->buffers_cnt; i++)
-			if(camera->buffers[i].start != MAP_FAILED)
-				munmap(camera->buffers[i].start,
-						camera->buffers[i].length);
-		free(camera->buffers);
-		camera->buffers = NULL;
-		camera->buffers_cnt = 0;
+		/* applied once opened */
+		camera->mode = mode;
+		camera->mode_valid = TRUE;
+		return 0;
 	}
-	else
-		free(camera->raw_buffer);
-	camera->raw_buffer = NULL;
-	camera->raw_buffer_cnt = 0;
+	/* the buffers cannot be freed while exported, even if displayed */
+	if(_camera_exported(camera) > 0)
+		return -error_set_code(1, "%s: %s", camera->device,
+				_("Frames are still exported"));
+	return _camera_set_mode(camera, &mode);
 }
 
 
@@ -1224,6 +1776,144 @@ static String * _camera_get_config_filename(Camera * camera, char const * name)
 
 
 /* useful */
+/* camera_apply_drop */
+static void _camera_apply_drop(Camera * camera,
+		struct v4l2_fract const * interval)
+{
+	unsigned int rate = camera->framerate;
+
+	/* slow down while in the background */
+	if((camera->unfocused || camera->iconified) && camera->idlerate > 0
+			&& (rate == 0 || camera->idlerate < rate))
+		rate = camera->idlerate;
+	/* drop the frames in excess, unless the device already slowed down */
+	g_mutex_lock(&camera->mutex);
+	camera->interval = (rate > 0 && (interval->numerator == 0
+				|| interval->denominator > (uint64_t)rate
+				* interval->numerator))
+		? G_USEC_PER_SEC / rate : 0;
+	camera->due = 0;
+	g_mutex_unlock(&camera->mutex);
+}
+
+
+/* camera_apply_idle */
+static void _camera_apply_idle(Camera * camera)
+{
+	struct v4l2_streamparm parm;
+	struct v4l2_fract * interval = &parm.parm.capture.timeperframe;
+
+	/* the device keeps its interval, only drop the frames in excess */
+	memset(&parm, 0, sizeof(parm));
+	parm.type = camera->type;
+	if(camera->input != NULL || camera->fd < 0
+			|| _camera_ioctl(camera, VIDIOC_G_PARM, &parm) != 0
+			|| (parm.parm.capture.capability
+				& V4L2_CAP_TIMEPERFRAME) == 0)
+		memset(interval, 0, sizeof(*interval));
+	_camera_apply_drop(camera, interval);
+}
+
+
+/* camera_apply_rate */
+static void _apply_rate_target(Camera * camera, struct v4l2_fract * interval);
+
+static void _camera_apply_rate(Camera * camera)
+{
+	struct v4l2_streamparm parm;
+	struct v4l2_fract * interval = &parm.parm.capture.timeperframe;
+
+	_apply_rate_target(camera, &camera->timeperframe);
+	memset(&parm, 0, sizeof(parm));
+	parm.type = camera->type;
+	if(camera->input != NULL || camera->fd < 0
+			|| _camera_ioctl(camera, VIDIOC_G_PARM, &parm) != 0
+			|| (parm.parm.capture.capability
+				& V4L2_CAP_TIMEPERFRAME) == 0)
+		memset(interval, 0, sizeof(*interval));
+	else if(camera->timeperframe.denominator != 0)
+	{
+		*interval = camera->timeperframe;
+		/* the driver picks the closest interval supported */
+		if(_camera_ioctl(camera, VIDIOC_S_PARM, &parm) != 0)
+			memset(interval, 0, sizeof(*interval));
+	}
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s() %u/%u\n", __func__,
+			interval->numerator, interval->denominator);
+#endif
+	_camera_apply_drop(camera, interval);
+}
+
+static void _apply_rate_target(Camera * camera, struct v4l2_fract * interval)
+{
+	/* the idle rate is never negotiated with the device */
+	if(camera->framerate > 0)
+	{
+		interval->numerator = 1;
+		interval->denominator = camera->framerate;
+	}
+	else if(camera->mode_valid && camera->mode.interval.numerator != 0
+			&& camera->mode.interval.denominator != 0)
+		*interval = camera->mode.interval;
+	else
+	{
+		/* the default of the device */
+		interval->numerator = 0;
+		interval->denominator = 0;
+	}
+}
+
+/* camera_convert */
+static int _camera_convert(Camera * camera, CameraConvertFormat format,
+		unsigned int shrink, unsigned char * dst, size_t dst_stride)
+{
+	struct v4l2_pix_format * pix = &camera->pix;
+	CameraConvertPlane planes[CAMERACONVERT_PLANES_MAX];
+
+	switch(pix->pixelformat)
+	{
+		case V4L2_PIX_FMT_JPEG:
+		case V4L2_PIX_FMT_MJPEG:
+			/* the destination is smaller when shrinking */
+			return cameradecode_mjpeg(camera->decode, format,
+					shrink,
+					(unsigned char *)camera->raw_buffer->start
+					+ camera->raw_buffer->offset,
+					camera->raw_buffer->used, dst,
+					dst_stride,
+					(pix->width + shrink - 1) / shrink,
+					(pix->height + shrink - 1) / shrink);
+		default:
+			break;
+	}
+	if(_camera_planes(camera, planes) == 0)
+	{
+#ifdef DEBUG
+		fprintf(stderr, "DEBUG: %s() Unsupported format\n", __func__);
+#endif
+		return -1;
+	}
+	return cameraconvert_frame(camera->convert, pix->pixelformat, format,
+			planes, pix->width, pix->height, dst, dst_stride);
+}
+
+
+/* camera_convert_cost */
+static unsigned int _camera_convert_cost(uint32_t pixelformat)
+{
+	switch(pixelformat)
+	{
+		case V4L2_PIX_FMT_JPEG:
+		case V4L2_PIX_FMT_MJPEG:
+			/* more expensive than converting raw colours */
+			return 4;
+		default:
+			return cameraconvert_cost(pixelformat);
+	}
+}
+
+
 /* camera_error */
 static int _error_text(char const * message, int ret);
 
@@ -1261,6 +1951,22 @@ static int _error_text(char const * message, int ret)
 }
 
 
+/* camera_exported */
+static size_t _camera_exported(Camera * camera)
+{
+	size_t ret = 0;
+	size_t i;
+
+	/* the frames exported, displayed or not */
+	g_mutex_lock(&camera->mutex);
+	for(i = 0; i < camera->buffers_cnt; i++)
+		if(camera->buffers[i * camera->planes_cnt].refs > 0)
+			ret++;
+	g_mutex_unlock(&camera->mutex);
+	return ret;
+}
+
+
 /* camera_ioctl */
 static int _camera_ioctl(Camera * camera, unsigned long request,
 		void * data)
@@ -1275,156 +1981,608 @@ static int _camera_ioctl(Camera * camera, unsigned long request,
 }
 
 
-/* callbacks */
-/* camera_on_can_mmap */
-static gboolean _camera_on_can_mmap(GIOChannel * channel,
-		GIOCondition condition, gpointer data)
+/* camera_letterbox */
+static void _camera_letterbox(Camera * camera, GdkRectangle * rect)
 {
-	Camera * camera = data;
+	GtkAllocation * allocation = &camera->area_allocation;
+	gdouble scale;
 
-#ifdef DEBUG
-	fprintf(stderr, "DEBUG: %s()\n", __func__);
-#endif
-	if(channel != camera->channel || condition != G_IO_IN)
-		return FALSE;
-	memset(&camera->buf, 0, sizeof(camera->buf));
-	camera->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	camera->buf.memory = V4L2_MEMORY_MMAP;
-	if(_camera_ioctl(camera, VIDIOC_DQBUF, &camera->buf) == -1)
-	{
-		_camera_error(camera, _("Could not dequeue buffer"), 1);
-		camera->source = 0;
-		return FALSE;
-	}
-	if(camera->buf.index >= camera->buffers_cnt)
+	if(camera->ratio == FALSE
+			|| camera->pix.width == 0 || camera->pix.height == 0)
 	{
-#ifdef DEBUG
-		fprintf(stderr, "DEBUG: %s() %u >= %zu\n", __func__,
-				camera->buf.index, camera->buffers_cnt);
-#endif
-		_camera_error(camera, _("Invalid buffer index"), 1);
-		camera->source = 0;
-		return FALSE;
+		rect->x = 0;
+		rect->y = 0;
+		rect->width = allocation->width;
+		rect->height = allocation->height;
+		return;
 	}
-	camera->raw_buffer = camera->buffers[camera->buf.index].start;
-	camera->raw_buffer_cnt = camera->buffers[camera->buf.index].length;
-#ifdef DEBUG
-	fprintf(stderr, "DEBUG: %s() %lu\n", __func__, camera->raw_buffer_cnt);
-#endif
-	camera->source = g_idle_add(_camera_on_refresh, camera);
-	return FALSE;
+	scale = (gdouble)allocation->width / camera->pix.width;
+	scale = MIN(scale, (gdouble)allocation->height
+			/ camera->pix.height);
+	rect->width = (gdouble)camera->pix.width * scale;
+	rect->width = MIN(rect->width, allocation->width);
+	rect->height = (gdouble)camera->pix.height * scale;
+	rect->height = MIN(rect->height, allocation->height);
+	rect->x = (allocation->width - rect->width) / 2;
+	rect->y = (allocation->height - rect->height) / 2;
 }
 
 
-/* camera_on_can_read */
-static gboolean _camera_on_can_read(GIOChannel * channel,
-		GIOCondition condition, gpointer data)
+/* camera_planes */
+static unsigned int _camera_planes(Camera * camera,
+		CameraConvertPlane planes[CAMERACONVERT_PLANES_MAX])
 {
-	Camera * camera = data;
-	GIOStatus status;
-	gsize size;
-	GError * error = NULL;
-
-#ifdef DEBUG
-	fprintf(stderr, "DEBUG: %s()\n", __func__);
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	struct v4l2_pix_format_mplane * mp = &camera->format.fmt.pix_mp;
+	size_t i;
 #endif
-	if(channel != camera->channel || condition != G_IO_IN)
-		return FALSE;
-	size = camera->raw_buffer_cnt;
-	status = g_io_channel_read_chars(channel, camera->raw_buffer,
-			camera->raw_buffer_cnt, &size, &error);
-	/* this status can be ignored */
-	if(status == G_IO_STATUS_AGAIN)
-		return TRUE;
-	if(status == G_IO_STATUS_ERROR)
-	{
-		g_io_channel_shutdown(camera->channel, TRUE, NULL);
-		g_io_channel_unref(camera->channel);
-		camera->channel = NULL;
-		camera->fd = -1;
-		_camera_error(camera, error->message, 1);
-		g_error_free(error);
-		gtk_widget_set_sensitive(GTK_WIDGET(
-					_camera_toolbar[CT_SNAPSHOT].widget),
-				FALSE);
-		gtk_widget_set_sensitive(GTK_WIDGET(
-					_camera_toolbar[CT_GALLERY].widget),
-				FALSE);
-		gtk_widget_set_sensitive(GTK_WIDGET(
-					_camera_toolbar[CT_PROPERTIES].widget),
-				FALSE);
-		camera->source = 0;
-		return FALSE;
+	CameraBuffer * buffer = camera->raw_buffer;
+	unsigned int ret;
+
+	if((ret = cameraconvert_planes(camera->pix.pixelformat,
+					(unsigned char *)buffer->start
+					+ buffer->offset, buffer->used,
+					camera->pix.bytesperline,
+					camera->pix.width, camera->pix.height,
+					planes)) == 0
+			|| camera->planes_cnt == 1)
+		return ret;
+	/* the planes are in separate buffers, as captured */
+	if(camera->planes_cnt != ret)
+		return 0;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	for(i = 1; i < camera->planes_cnt; i++)
+	{
+		planes[i].data = (unsigned char *)buffer[i].start
+			+ buffer[i].offset;
+		if(mp->plane_fmt[i].bytesperline != 0)
+			planes[i].stride = mp->plane_fmt[i].bytesperline;
+		planes[i].size = MIN(buffer[i].used, planes[i].stride
+				* ((camera->pix.height + 1) / 2));
 	}
-#ifdef DEBUG
-	fprintf(stderr, "DEBUG: %s() %lu %lu\n", __func__,
-			camera->raw_buffer_cnt, size);
 #endif
-	camera->source = g_idle_add(_camera_on_refresh, camera);
-	return FALSE;
+	return ret;
 }
 
 
-#if GTK_CHECK_VERSION(3, 0, 0)
-/* camera_on_drawing_area_configure */
-static gboolean _camera_on_drawing_area_configure(GtkWidget * widget,
-		GdkEventConfigure * event, gpointer data)
+/* camera_free_buffers */
+static void _camera_free_buffers(Camera * camera)
 {
-	Camera * camera = data;
-	GtkAllocation * allocation = &camera->area_allocation;
-	cairo_t * cr;
-	(void) event;
+	enum v4l2_buf_type type = camera->type;
+	CameraBuffer * buffers;
+	size_t cnt;
+	size_t i;
 
-	gtk_widget_get_allocation(widget, allocation);
-#ifdef DEBUG
-	fprintf(stderr, "DEBUG: %s() %dx%d\n", __func__, allocation->width,
-			allocation->height);
-#endif
-	if(camera->surface != NULL)
-		cairo_surface_destroy(camera->surface);
-	camera->surface = gdk_window_create_similar_surface(
-			gtk_widget_get_window(widget), CAIRO_CONTENT_COLOR,
-			allocation->width, allocation->height);
-	cr = cairo_create(camera->surface);
-	cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
-	cairo_paint(cr);
-	cairo_destroy(cr);
-	return TRUE;
+	if(camera->streaming && camera->fd >= 0)
+		/* XXX we ignore errors at this point */
+		_camera_ioctl(camera, VIDIOC_STREAMOFF, &type);
+	/* the frames still exported cannot be released anymore */
+	g_mutex_lock(&camera->mutex);
+	buffers = camera->buffers;
+	cnt = camera->buffers_cnt * camera->planes_cnt;
+	camera->buffers = NULL;
+	camera->buffers_cnt = 0;
+	camera->generation++;
+	camera->raw_buffer = NULL;
+	g_mutex_unlock(&camera->mutex);
+	for(i = 0; i < cnt; i++)
+	{
+		if(buffers[i].fd >= 0)
+			close(buffers[i].fd);
+		if(!camera->streaming)
+			free(buffers[i].start);
+		else if(camera->memory == V4L2_MEMORY_USERPTR)
+			camerapool_free(camera->pool, buffers[i].start);
+		else if(buffers[i].start != MAP_FAILED)
+			munmap(buffers[i].start, buffers[i].length);
+	}
+	free(buffers);
+	camera->streaming = FALSE;
+	camera->memory = V4L2_MEMORY_MMAP;
+	free(camera->ready);
+	camera->ready = NULL;
+	camera->ready_cnt = 0;
+	camera->ready_max = 0;
+	free(camera->done);
+	camera->done = NULL;
+	camera->done_cnt = 0;
+	camera->held_cnt = 0;
 }
 
 
-/* camera_on_drawing_area_draw */
-static gboolean _camera_on_drawing_area_draw(GtkWidget * widget, cairo_t * cr,
-		gpointer data)
+/* camera_set_rate */
+static void _camera_set_rate(Camera * camera)
 {
-	Camera * camera = data;
-	(void) widget;
+	struct v4l2_fract target;
 
-#ifdef DEBUG
-	fprintf(stderr, "DEBUG: %s()\n", __func__);
-#endif
-	cairo_set_source_surface(cr, camera->surface, 0, 0);
-	cairo_paint(cr);
-	return FALSE;
+	if(camera->streaming == FALSE)
+	{
+		_camera_apply_rate(camera);
+		return;
+	}
+	/* the drivers only accept another interval before streaming */
+	_apply_rate_target(camera, &target);
+	if(target.denominator != 0
+			&& (target.numerator != camera->timeperframe.numerator
+				|| target.denominator
+				!= camera->timeperframe.denominator)
+			&& _camera_exported(camera) == 0)
+	{
+		_camera_stop_buffers(camera);
+		_camera_start_buffers(camera);
+		return;
+	}
+	/* keep the current interval otherwise */
+	_camera_apply_idle(camera);
 }
 
 
-/* camera_on_drawing_area_size_allocate */
-static void _camera_on_drawing_area_size_allocate(GtkWidget * widget,
-		GdkRectangle * allocation, gpointer data)
+/* camera_set_visible */
+static void _camera_set_visible(Camera * camera)
 {
-	Camera * camera = data;
-	(void) widget;
+	gboolean visible;
 
+	visible = (camera->mapped && !camera->iconified && !camera->obscured)
+		? TRUE : FALSE;
+	if(visible == camera->visible)
+		return;
 #ifdef DEBUG
-	fprintf(stderr, "DEBUG: %s()\n", __func__);
+	fprintf(stderr, "DEBUG: %s(%s)\n", __func__, visible ? "TRUE"
+			: "FALSE");
 #endif
-	camera->area_allocation = *allocation;
+	camera->visible = visible;
+	/* catch up with the next frame captured */
+	if(visible)
+		gtk_widget_queue_draw(camera->area);
 }
 
-#else
 
-/* camera_on_drawing_area_configure */
+/* camera_stop_capture */
+static void _camera_stop_capture(Camera * camera)
+{
+	size_t i;
+
+	if(camera->thread != NULL)
+	{
+		g_mutex_lock(&camera->mutex);
+		camera->running = FALSE;
+		g_mutex_unlock(&camera->mutex);
+		if(write(camera->wakeup[1], "", 1) != 1 && errno != EAGAIN)
+			_camera_error(NULL, strerror(errno), 1);
+		g_thread_join(camera->thread);
+		camera->thread = NULL;
+	}
+	if(camera->refresh != 0)
+		g_source_remove(camera->refresh);
+	camera->refresh = 0;
+#if GTK_CHECK_VERSION(3, 8, 0)
+	if(camera->tick != 0)
+		gtk_widget_remove_tick_callback(camera->area, camera->tick);
+	camera->tick = 0;
+#endif
+	for(i = 0; i < sizeof(camera->wakeup) / sizeof(*camera->wakeup); i++)
+	{
+		if(camera->wakeup[i] >= 0)
+			close(camera->wakeup[i]);
+		camera->wakeup[i] = -1;
+	}
+	free(camera->error);
+	camera->error = NULL;
+}
+
+
+/* callbacks */
+/* camera_capture */
+static int _capture_dequeue(Camera * camera, size_t * index);
+static int _capture_drain(Camera * camera, size_t * index);
+static int _capture_enqueue(Camera * camera, size_t index);
+static int _capture_error(Camera * camera, char const * message);
+static int _capture_event(Camera * camera);
+static void _capture_push(Camera * camera, size_t index);
+static int _capture_queue(Camera * camera);
+
+static gpointer _camera_capture(gpointer data)
+{
+	Camera * camera = data;
+	struct pollfd pfd[2];
+	size_t index;
+	char buf[16];
+	int res;
+	int timeout;
+	const gboolean drain = camera->lowlatency && camera->streaming;
+
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s()\n", __func__);
+#endif
+	pfd[0].fd = camera->wakeup[0];
+	pfd[0].events = POLLIN;
+	pfd[1].fd = camera->fd;
+	for(;;)
+	{
+		/* give the buffers rendered back to the device */
+		if((res = _capture_queue(camera)) < 0)
+		{
+			_capture_error(camera, _("Could not queue buffer"));
+			break;
+		}
+		else if(res == 0)
+			break;
+		pfd[1].events = ((res > 1) ? POLLIN : 0)
+			| (camera->events ? POLLPRI : 0);
+		pfd[0].revents = 0;
+		pfd[1].revents = 0;
+		/* the sources pace the frames themselves */
+		timeout = (camera->input != NULL && res > 1)
+			? camerasource_get_timeout(camera->input) : -1;
+		if(poll(pfd, sizeof(pfd) / sizeof(*pfd), timeout) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			_capture_error(camera, strerror(errno));
+			break;
+		}
+		if(pfd[0].revents & POLLIN)
+			while(read(camera->wakeup[0], buf, sizeof(buf)) > 0);
+		/* the input signal changed or ended */
+		if((pfd[1].revents & POLLPRI)
+				&& (res = _capture_event(camera)) != 0)
+		{
+			/* renegotiate from the main loop */
+			g_mutex_lock(&camera->mutex);
+			if(res > 0 && camera->change == 0)
+				camera->change = g_idle_add(_camera_on_change,
+						camera);
+			g_mutex_unlock(&camera->mutex);
+			break;
+		}
+		if(pfd[1].revents & (POLLERR | POLLHUP | POLLNVAL))
+		{
+			_capture_error(camera, _("Could not dequeue buffer"));
+			break;
+		}
+		if((camera->input != NULL) ? res < 2
+				: (pfd[1].revents & POLLIN) == 0)
+			continue;
+		if((res = _capture_dequeue(camera, &index)) == 0 && drain)
+			/* keep the most recent frame only */
+			res = _capture_drain(camera, &index);
+		if(res < 0)
+			break;
+		else if(res == 0)
+			_capture_push(camera, index);
+	}
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s() exiting\n", __func__);
+#endif
+	return NULL;
+}
+
+static int _capture_dequeue(Camera * camera, size_t * index)
+{
+	struct v4l2_buffer buf;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	size_t i;
+#endif
+	CameraBuffer * buffer;
+	ssize_t size;
+	size_t used;
+	int res;
+
+	if(camera->streaming)
+	{
+		memset(&buf, 0, sizeof(buf));
+		buf.type = camera->type;
+		buf.memory = camera->memory;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+		if(camera->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+		{
+			memset(planes, 0, sizeof(planes));
+			buf.m.planes = planes;
+			buf.length = camera->planes_cnt;
+		}
+#endif
+		if(_camera_ioctl(camera, VIDIOC_DQBUF, &buf) == -1)
+		{
+			if(errno == EAGAIN)
+				return 1;
+			return _capture_error(camera,
+					_("Could not dequeue buffer"));
+		}
+		if(buf.index >= camera->buffers_cnt)
+		{
+#ifdef DEBUG
+			fprintf(stderr, "DEBUG: %s() %u >= %zu\n", __func__,
+					buf.index, camera->buffers_cnt);
+#endif
+			return _capture_error(camera,
+					_("Invalid buffer index"));
+		}
+#ifdef V4L2_BUF_FLAG_ERROR
+		/* do not render corrupted frames */
+		if(buf.flags & V4L2_BUF_FLAG_ERROR)
+			return (_capture_enqueue(camera, buf.index) == 0) ? 1
+				: _capture_error(camera,
+						_("Could not queue buffer"));
+#endif
+		*index = buf.index;
+		buffer = &camera->buffers[*index * camera->planes_cnt];
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+		if(camera->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+			/* the offset is included in the size used */
+			for(i = 0; i < camera->planes_cnt; i++)
+			{
+				buffer[i].offset = MIN(planes[i].data_offset,
+						buffer[i].length);
+				buffer[i].used = MIN(planes[i].bytesused,
+						buffer[i].length)
+					- buffer[i].offset;
+			}
+		else
+#endif
+		{
+			buffer->offset = 0;
+			buffer->used = MIN(buf.bytesused, buffer->length);
+		}
+		/* count the frames lost by the device */
+		g_mutex_lock(&camera->mutex);
+		if(camera->frames > 0 && buf.sequence - camera->sequence > 1)
+			camera->dropped += buf.sequence - camera->sequence - 1;
+		camera->sequence = buf.sequence;
+		camera->frames++;
+		g_mutex_unlock(&camera->mutex);
+		return 0;
+	}
+	/* obtain a free buffer */
+	g_mutex_lock(&camera->mutex);
+	*index = camera->done[--camera->done_cnt];
+	g_mutex_unlock(&camera->mutex);
+	buffer = &camera->buffers[*index];
+	if(camera->input != NULL)
+	{
+		if((res = camerasource_read(camera->input, buffer->start,
+						buffer->length, &used)) < 0)
+			_capture_error(camera,
+					camerasource_get_error(camera->input));
+	}
+	else if((size = read(camera->fd, buffer->start, buffer->length)) > 0)
+	{
+		res = 0;
+		used = size;
+	}
+	else if(size < 0 && (errno == EAGAIN || errno == EINTR))
+		res = 1;
+	else
+		res = _capture_error(camera, (size == 0) ? _("End of stream")
+				: strerror(errno));
+	if(res != 0)
+	{
+		g_mutex_lock(&camera->mutex);
+		camera->done[camera->done_cnt++] = *index;
+		g_mutex_unlock(&camera->mutex);
+		return res;
+	}
+	buffer->offset = 0;
+	buffer->used = used;
+	return 0;
+}
+
+static int _capture_drain(Camera * camera, size_t * index)
+{
+	size_t latest;
+	int res;
+
+	/* the stale frames go straight back to the device */
+	while((res = _capture_dequeue(camera, &latest)) == 0)
+	{
+		if(_capture_enqueue(camera, *index) != 0)
+			return _capture_error(camera,
+					_("Could not queue buffer"));
+		*index = latest;
+	}
+	return (res < 0) ? res : 0;
+}
+
+static int _capture_enqueue(Camera * camera, size_t index)
+{
+	struct v4l2_buffer buf;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	size_t i;
+#endif
+	CameraBuffer * buffer = &camera->buffers[index * camera->planes_cnt];
+	const gboolean userptr = (camera->memory == V4L2_MEMORY_USERPTR);
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type = camera->type;
+	buf.memory = camera->memory;
+	buf.index = index;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	if(camera->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+	{
+		memset(planes, 0, sizeof(planes));
+		for(i = 0; userptr && i < camera->planes_cnt; i++)
+		{
+			planes[i].m.userptr = (unsigned long)buffer[i].start;
+			planes[i].length = buffer[i].length;
+		}
+		buf.m.planes = planes;
+		buf.length = camera->planes_cnt;
+	}
+	else
+#endif
+	if(userptr)
+	{
+		buf.m.userptr = (unsigned long)buffer->start;
+		buf.length = buffer->length;
+	}
+	return (_camera_ioctl(camera, VIDIOC_QBUF, &buf) == -1) ? -1 : 0;
+}
+
+static int _capture_event(Camera * camera)
+{
+	int ret = 0;
+#ifdef V4L2_EVENT_SOURCE_CHANGE
+	struct v4l2_event event;
+
+	for(;;)
+	{
+		memset(&event, 0, sizeof(event));
+		if(_camera_ioctl(camera, VIDIOC_DQEVENT, &event) == -1)
+			break;
+# ifdef DEBUG
+		fprintf(stderr, "DEBUG: %s() event %u\n", __func__,
+				event.type);
+# endif
+		if(event.type == V4L2_EVENT_EOS)
+			return _capture_error(camera, _("End of stream"));
+		if(event.type == V4L2_EVENT_SOURCE_CHANGE
+				&& (event.u.src_change.changes
+					& V4L2_EVENT_SRC_CH_RESOLUTION))
+			ret = 1;
+	}
+#else
+	(void) camera;
+#endif
+	return ret;
+}
+
+static int _capture_error(Camera * camera, char const * message)
+{
+	char buf[256];
+
+	/* the error code of libSystem belongs to the main thread */
+	snprintf(buf, sizeof(buf), "%s: %s", camera->device, message);
+	g_mutex_lock(&camera->mutex);
+	if(camera->error == NULL)
+		camera->error = strdup(buf);
+	if(camera->refresh == 0)
+		camera->refresh = g_idle_add(_camera_on_refresh, camera);
+	g_mutex_unlock(&camera->mutex);
+	return -1;
+}
+
+static void _capture_push(Camera * camera, size_t index)
+{
+	gint64 now;
+
+	g_mutex_lock(&camera->mutex);
+	if(camera->interval > 0)
+	{
+		/* allow for some jitter from the device */
+		now = g_get_monotonic_time();
+		if(now < camera->due - camera->interval / 8)
+		{
+			camera->done[camera->done_cnt++] = index;
+			g_mutex_unlock(&camera->mutex);
+			return;
+		}
+		/* without catching up after a stall */
+		camera->due = ((camera->due > now - camera->interval)
+				? camera->due : now) + camera->interval;
+	}
+	if(camera->ready_cnt == camera->ready_max)
+	{
+		/* drop the oldest frame */
+		camera->done[camera->done_cnt++] = camera->ready[0];
+		memmove(camera->ready, &camera->ready[1],
+				--camera->ready_cnt * sizeof(*camera->ready));
+	}
+	camera->ready[camera->ready_cnt++] = index;
+	if(camera->refresh == 0)
+		camera->refresh = g_idle_add(_camera_on_refresh, camera);
+	g_mutex_unlock(&camera->mutex);
+}
+
+static int _capture_queue(Camera * camera)
+{
+	int ret = 1;
+
+	g_mutex_lock(&camera->mutex);
+	if(camera->running == FALSE)
+		ret = 0;
+	else if(camera->streaming)
+		for(; camera->done_cnt > 0; camera->done_cnt--)
+			if(_capture_enqueue(camera,
+						camera->done[camera->done_cnt
+						- 1]) != 0)
+			{
+				ret = -1;
+				break;
+			}
+	/* we can read again if the device has a buffer to fill */
+	if(ret > 0 && (camera->streaming ? camera->ready_cnt
+				+ ((camera->raw_buffer != NULL) ? 1 : 0)
+				+ camera->held_cnt < camera->buffers_cnt
+				: camera->done_cnt > 0))
+		ret = 2;
+	g_mutex_unlock(&camera->mutex);
+	return ret;
+}
+
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+/* camera_on_drawing_area_configure */
+static gboolean _camera_on_drawing_area_configure(GtkWidget * widget,
+		GdkEventConfigure * event, gpointer data)
+{
+	Camera * camera = data;
+	GtkAllocation * allocation = &camera->area_allocation;
+	cairo_t * cr;
+	(void) event;
+
+	gtk_widget_get_allocation(widget, allocation);
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s() %dx%d\n", __func__, allocation->width,
+			allocation->height);
+#endif
+	if(camera->surface != NULL)
+		cairo_surface_destroy(camera->surface);
+	camera->surface = gdk_window_create_similar_surface(
+			gtk_widget_get_window(widget), CAIRO_CONTENT_COLOR,
+			allocation->width, allocation->height);
+	/* the frames are then only drawn within the borders */
+	cr = cairo_create(camera->surface);
+	cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	_camera_letterbox(camera, &camera->letterbox);
+	return TRUE;
+}
+
+
+/* camera_on_drawing_area_draw */
+static gboolean _camera_on_drawing_area_draw(GtkWidget * widget, cairo_t * cr,
+		gpointer data)
+{
+	Camera * camera = data;
+	(void) widget;
+
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s()\n", __func__);
+#endif
+	cairo_set_source_surface(cr, camera->surface, 0, 0);
+	cairo_paint(cr);
+	return FALSE;
+}
+
+
+/* camera_on_drawing_area_size_allocate */
+static void _camera_on_drawing_area_size_allocate(GtkWidget * widget,
+		GdkRectangle * allocation, gpointer data)
+{
+	Camera * camera = data;
+	(void) widget;
+
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s()\n", __func__);
+#endif
+	camera->area_allocation = *allocation;
+}
+
+#else
+
+/* camera_on_drawing_area_configure */
 static gboolean _camera_on_drawing_area_configure(GtkWidget * widget,
 		GdkEventConfigure * event, gpointer data)
 {
@@ -1447,6 +2605,8 @@ static gboolean _camera_on_drawing_area_configure(GtkWidget * widget,
 	/* FIXME is it not better to scale the previous pixmap for now? */
 	gdk_draw_rectangle(camera->pixmap, camera->gc, TRUE, 0, 0,
 			allocation->width, allocation->height);
+	/* the frames are then only drawn within the borders */
+	_camera_letterbox(camera, &camera->letterbox);
 	return TRUE;
 }
 
@@ -1467,6 +2627,71 @@ static gboolean _camera_on_drawing_area_expose(GtkWidget * widget,
 #endif
 
 
+/* camera_on_drawing_area_map */
+static void _camera_on_drawing_area_map(GtkWidget * widget, gpointer data)
+{
+	Camera * camera = data;
+
+	/* also when the desktop widget is unmapped */
+	camera->mapped = gtk_widget_get_mapped(widget);
+	_camera_set_visible(camera);
+}
+
+
+#if !GTK_CHECK_VERSION(3, 0, 0)
+/* camera_on_drawing_area_visibility */
+static gboolean _camera_on_drawing_area_visibility(GtkWidget * widget,
+		GdkEventVisibility * event, gpointer data)
+{
+	Camera * camera = data;
+	(void) widget;
+
+	camera->obscured = (event->state == GDK_VISIBILITY_FULLY_OBSCURED)
+		? TRUE : FALSE;
+	_camera_set_visible(camera);
+	return FALSE;
+}
+#endif
+
+/* camera_on_change */
+static gboolean _camera_on_change(gpointer data)
+{
+	Camera * camera = data;
+
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s()\n", __func__);
+#endif
+	g_mutex_lock(&camera->mutex);
+	camera->change = 0;
+	camera->renegotiate = TRUE;
+	g_mutex_unlock(&camera->mutex);
+	/* the buffers cannot be freed while exported (retried once released) */
+	if(_camera_exported(camera) > 0)
+		return FALSE;
+	g_mutex_lock(&camera->mutex);
+	camera->renegotiate = FALSE;
+	g_mutex_unlock(&camera->mutex);
+	/* follow the new input signal */
+	if(_camera_set_mode(camera, NULL) != 0)
+		_camera_error(camera, error_get(NULL), 1);
+	return FALSE;
+}
+
+
+/* camera_on_focus */
+static gboolean _camera_on_focus(GtkWidget * widget, GdkEventFocus * event,
+		gpointer data)
+{
+	Camera * camera = data;
+	(void) widget;
+
+	camera->unfocused = event->in ? FALSE : TRUE;
+	if(camera->idlerate > 0)
+		_camera_apply_idle(camera);
+	return FALSE;
+}
+
+
 /* camera_on_fullscreen */
 static void _camera_on_fullscreen(gpointer data)
 {
@@ -1494,18 +2719,26 @@ static void _camera_on_gallery(gpointer data)
 
 /* camera_on_open */
 static int _open_setup(Camera * camera);
+static int _open_setup_capture(Camera * camera);
 static int _open_setup_mmap(Camera * camera);
 static int _open_setup_read(Camera * camera);
+static int _open_setup_source(Camera * camera);
+static int _open_setup_thread(Camera * camera);
+static int _open_setup_userptr(Camera * camera);
 
 static gboolean _camera_on_open(gpointer data)
 {
 	Camera * camera = data;
+	int ret;
 
 #ifdef DEBUG
 	fprintf(stderr, "DEBUG: %s() \"%s\"\n", __func__, camera->device);
 #endif
 	camera->source = 0;
-	if((camera->fd = open(camera->device, O_RDWR)) < 0)
+	if(camerasource_probe(camera->device))
+		ret = _open_setup_source(camera);
+	/* the capture thread polls before reading */
+	else if((camera->fd = open(camera->device, O_RDWR | O_NONBLOCK)) < 0)
 	{
 		error_set_code(-errno, "%s: %s (%s)", camera->device,
 				_("Could not open the video capture device"),
@@ -1513,18 +2746,24 @@ static gboolean _camera_on_open(gpointer data)
 		_camera_error(camera, error_get(NULL), 1);
 		return FALSE;
 	}
-	if(_open_setup(camera) != 0)
+	else
+		ret = _open_setup(camera);
+	if(ret != 0)
 	{
 		_camera_error(camera, error_get(NULL), 1);
-		close(camera->fd);
+		_camera_free_buffers(camera);
+		if(camera->input != NULL)
+			camerasource_delete(camera->input);
+		camera->input = NULL;
+		if(camera->fd >= 0)
+			close(camera->fd);
 		camera->fd = -1;
-		/* FIXME also free camera->buffers */
 		return FALSE;
 	}
 #ifdef DEBUG
 	fprintf(stderr, "DEBUG: %s() %dx%d\n", __func__,
-			camera->format.fmt.pix.width,
-			camera->format.fmt.pix.height);
+			camera->pix.width,
+			camera->pix.height);
 #endif
 	gtk_widget_set_sensitive(
 			GTK_WIDGET(_camera_toolbar[CT_SNAPSHOT].widget), TRUE);
@@ -1536,28 +2775,49 @@ static gboolean _camera_on_open(gpointer data)
 	return FALSE;
 }
 
+static int _setup_buffers(Camera * camera, enum v4l2_memory memory);
+static void _setup_events(Camera * camera);
+static int _setup_export(Camera * camera);
+static void _setup_format(Camera * camera, struct v4l2_format const * format);
+static int _setup_mode(Camera * camera, CameraMode const * mode);
+static int _setup_negotiate(Camera * camera, CameraMode * mode);
+static int _setup_stream(Camera * camera);
+static void _negotiate_candidate(Camera * camera, CameraMode const * candidate,
+		CameraMode * best, gboolean * found);
+static void _negotiate_intervals(Camera * camera, CameraMode * candidate,
+		CameraMode * best, gboolean * found);
+static void _negotiate_sizes(Camera * camera, CameraMode * candidate,
+		CameraMode * best, gboolean * found);
+
 static int _open_setup(Camera * camera)
 {
-	int ret;
 	struct v4l2_cropcap cropcap;
 	struct v4l2_crop crop;
-	GError * error = NULL;
+	struct v4l2_format format;
+	CameraMode mode;
 
 	/* check for capabilities */
 	if(_camera_ioctl(camera, VIDIOC_QUERYCAP, &camera->cap) == -1)
 		return error_set_code(-errno, "%s: %s (%s)", camera->device,
 				_("Could not obtain the capabilities"),
 				strerror(errno));
-	if((camera->cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) == 0)
+	if((camera->cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) != 0)
+		camera->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	else if((camera->cap.capabilities & V4L2_CAP_VIDEO_CAPTURE_MPLANE)
+			!= 0)
+		camera->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+#endif
+	else
 		return -error_set_code(1, "%s: %s", camera->device,
 				_("Not a video capture device"));
 	/* reset cropping */
 	memset(&cropcap, 0, sizeof(cropcap));
-	cropcap.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	cropcap.type = camera->type;
 	if(_camera_ioctl(camera, VIDIOC_CROPCAP, &cropcap) == 0)
 	{
 		/* reset to default */
-		crop.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		crop.type = camera->type;
 		crop.c = cropcap.defrect;
 		if(_camera_ioctl(camera, VIDIOC_S_CROP, &crop) == -1
 				&& errno == EINVAL)
@@ -1566,33 +2826,58 @@ static int _open_setup(Camera * camera)
 					_("Cropping not supported"));
 	}
 	/* obtain the current format */
-	camera->format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	if(_camera_ioctl(camera, VIDIOC_G_FMT, &camera->format) == -1)
+	memset(&format, 0, sizeof(format));
+	format.type = camera->type;
+	if(_camera_ioctl(camera, VIDIOC_G_FMT, &format) == -1)
 		return -error_set_code(1, "%s: %s", camera->device,
 				_("Could not obtain the video capture format"));
-	/* try to set a specific format */
-	if(camera->format.fmt.pix.pixelformat != V4L2_PIX_FMT_YUYV)
+	_setup_format(camera, &format);
+	/* negotiate the best format available */
+	if(camera->mode_valid == FALSE
+			&& _setup_negotiate(camera, &camera->mode) == 0)
+		camera->mode_valid = TRUE;
+	if(camera->mode_valid && _setup_mode(camera, &camera->mode) != 0)
+		/* try again next time */
+		camera->mode_valid = FALSE;
+	/* otherwise try to set a specific format */
+	if(camera->mode_valid == FALSE
+			&& _camera_convert_cost(camera->pix.pixelformat) == 0)
 	{
-		camera->format.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-		if(_camera_ioctl(camera, VIDIOC_S_FMT, &camera->format) == -1)
+		memset(&mode, 0, sizeof(mode));
+		mode.pixelformat = V4L2_PIX_FMT_YUYV;
+		mode.width = camera->pix.width;
+		mode.height = camera->pix.height;
+		if(_setup_mode(camera, &mode) != 0)
 			return -error_set_code(1, "%s: %s", camera->device,
 					_("Could not set the video capture format"));
-		/* refresh the current format */
-		if(_camera_ioctl(camera, VIDIOC_G_FMT, &camera->format) == -1)
-			return -error_set_code(1, "%s: %s", camera->device,
-					_("Could not obtain the video capture format"));
 	}
+	_setup_events(camera);
+	return _open_setup_capture(camera);
+}
+
+static int _open_setup_capture(Camera * camera)
+{
+	int ret;
+
 	/* verify the current format */
-	if(camera->format.type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+	if(camera->format.type != camera->type)
 		return -error_set_code(1, "%s: %s", camera->device,
 				_("Unsupported video capture type"));
+	/* before requesting the buffers */
+	_camera_apply_rate(camera);
 	if((camera->cap.capabilities & V4L2_CAP_STREAMING) != 0)
 	{
-		if((ret = _open_setup_mmap(camera)) != 0
-				&& (camera->cap.capabilities
+		ret = -1;
+		if(camera->userptr
+				&& (ret = _open_setup_userptr(camera)) != 0)
+			/* fallback to memory mapping */
+			_camera_free_buffers(camera);
+		if(ret != 0)
+			ret = _open_setup_mmap(camera);
+		if(ret != 0 && (camera->cap.capabilities
 					& V4L2_CAP_READWRITE) != 0)
 		{
-			camera_stop(camera);
+			_camera_free_buffers(camera);
 			ret = _open_setup_read(camera);
 		}
 	}
@@ -1603,124 +2888,685 @@ static int _open_setup(Camera * camera)
 				_("Unsupported capabilities"));
 	if(ret != 0)
 		return ret;
-	/* setup an I/O channel */
-	camera->channel = g_io_channel_unix_new(camera->fd);
-	if(g_io_channel_set_encoding(camera->channel, NULL, &error)
-			!= G_IO_STATUS_NORMAL)
-	{
-		error_set_code(1, "%s", error->message);
-		g_error_free(error);
-		return -1;
-	}
-	g_io_channel_set_buffered(camera->channel, FALSE);
-	camera->source = g_io_add_watch(camera->channel, G_IO_IN,
-			(camera->buffers != NULL) ? _camera_on_can_mmap
-			: _camera_on_can_read, camera);
-	return 0;
+	return _open_setup_thread(camera);
 }
 
-static int _open_setup_mmap(Camera * camera)
+static void _setup_format(Camera * camera, struct v4l2_format const * format)
 {
-	struct v4l2_requestbuffers req;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	struct v4l2_pix_format_mplane const * mp = &format->fmt.pix_mp;
 	size_t i;
-	struct v4l2_buffer buf;
-	enum v4l2_buf_type type;
-	size_t cnt;
-	char * p;
+#endif
+
+	camera->format = *format;
+	camera->planes_cnt = 1;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	if(format->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+#endif
+	{
+		camera->pix = format->fmt.pix;
+		return;
+	}
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	/* the first plane holds the luminance, if not everything */
+	memset(&camera->pix, 0, sizeof(camera->pix));
+	camera->pix.width = mp->width;
+	camera->pix.height = mp->height;
+	camera->pix.pixelformat = mp->pixelformat;
+	camera->pix.field = mp->field;
+	camera->pix.colorspace = mp->colorspace;
+	camera->pix.bytesperline = mp->plane_fmt[0].bytesperline;
+	camera->planes_cnt = MIN(MAX(mp->num_planes, 1), VIDEO_MAX_PLANES);
+	for(i = 0; i < camera->planes_cnt; i++)
+		camera->pix.sizeimage += mp->plane_fmt[i].sizeimage;
+#endif
+}
+
+static int _setup_mode(Camera * camera, CameraMode const * mode)
+{
+	struct v4l2_format format = camera->format;
+	struct v4l2_streamparm parm;
 
 #ifdef DEBUG
-	fprintf(stderr, "DEBUG: %s()\n", __func__);
+	fprintf(stderr, "DEBUG: %s() 0x%08x %ux%u %u/%u\n", __func__,
+			mode->pixelformat, mode->width, mode->height,
+			mode->interval.numerator, mode->interval.denominator);
 #endif
-	/* memory mapping support */
-	req.count = 4;
-	req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	req.memory = V4L2_MEMORY_MMAP;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	if(format.type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+	{
+		format.fmt.pix_mp.pixelformat = mode->pixelformat;
+		format.fmt.pix_mp.width = mode->width;
+		format.fmt.pix_mp.height = mode->height;
+		format.fmt.pix_mp.field = V4L2_FIELD_ANY;
+		/* let the driver lay out the planes */
+		format.fmt.pix_mp.num_planes = 0;
+		memset(format.fmt.pix_mp.plane_fmt, 0,
+				sizeof(format.fmt.pix_mp.plane_fmt));
+	}
+	else
+#endif
+	{
+		format.fmt.pix.pixelformat = mode->pixelformat;
+		format.fmt.pix.width = mode->width;
+		format.fmt.pix.height = mode->height;
+		format.fmt.pix.bytesperline = 0;
+		format.fmt.pix.field = V4L2_FIELD_ANY;
+	}
+	if(_camera_ioctl(camera, VIDIOC_S_FMT, &format) == -1
+			|| _camera_ioctl(camera, VIDIOC_G_FMT, &format) == -1)
+		return -1;
+	_setup_format(camera, &format);
+	if(_camera_convert_cost(camera->pix.pixelformat) == 0)
+		return -1;
+	/* set the frame rate as well, when possible */
+	memset(&parm, 0, sizeof(parm));
+	parm.type = camera->type;
+	if(mode->interval.numerator == 0 || mode->interval.denominator == 0
+			|| _camera_ioctl(camera, VIDIOC_G_PARM, &parm) == -1
+			|| (parm.parm.capture.capability
+				& V4L2_CAP_TIMEPERFRAME) == 0)
+		return 0;
+	parm.parm.capture.timeperframe = mode->interval;
+	/* XXX ignore errors */
+	_camera_ioctl(camera, VIDIOC_S_PARM, &parm);
+	return 0;
+}
+
+static int _setup_negotiate(Camera * camera, CameraMode * mode)
+{
+	struct v4l2_fmtdesc fmtdesc;
+	CameraMode candidate;
+	gboolean found = FALSE;
+
+	memset(&fmtdesc, 0, sizeof(fmtdesc));
+	fmtdesc.type = camera->type;
+	for(; _camera_ioctl(camera, VIDIOC_ENUM_FMT, &fmtdesc) == 0;
+			fmtdesc.index++)
+	{
+		memset(&candidate, 0, sizeof(candidate));
+		if((candidate.cost = _camera_convert_cost(fmtdesc.pixelformat))
+				== 0)
+			continue;
+		candidate.pixelformat = fmtdesc.pixelformat;
+		_negotiate_sizes(camera, &candidate, mode, &found);
+	}
+	return found ? 0 : -1;
+}
+
+static void _negotiate_candidate(Camera * camera, CameraMode const * candidate,
+		CameraMode * best, gboolean * found)
+{
+	uint64_t fps[2];
+	uint64_t area[2];
+	uint64_t distance[2];
+	CameraMode const * mode[2] = { candidate, best };
+	int i;
+	int cmp[3];
+
+	if(*found == FALSE)
+	{
+		*best = *candidate;
+		*found = TRUE;
+		return;
+	}
+	for(i = 0; i < 2; i++)
+	{
+		/* frame rate, in thousandths of frames per second */
+		fps[i] = (mode[i]->interval.numerator != 0)
+			? (uint64_t)mode[i]->interval.denominator * 1000
+			/ mode[i]->interval.numerator : 0;
+		area[i] = (uint64_t)mode[i]->width * mode[i]->height;
+		distance[i] = ((mode[i]->width > camera->policy_width)
+				? mode[i]->width - camera->policy_width
+				: camera->policy_width - mode[i]->width)
+			+ ((mode[i]->height > camera->policy_height)
+					? mode[i]->height
+					- camera->policy_height
+					: camera->policy_height
+					- mode[i]->height);
+	}
+	cmp[0] = (fps[0] > fps[1]) ? 1 : ((fps[0] < fps[1]) ? -1 : 0);
+	cmp[1] = (area[0] > area[1]) ? 1 : ((area[0] < area[1]) ? -1 : 0);
+	cmp[2] = (distance[0] < distance[1]) ? 1
+		: ((distance[0] > distance[1]) ? -1 : 0);
+	switch(camera->policy)
+	{
+		case CP_RESOLUTION:
+			i = (cmp[1] != 0) ? cmp[1] : cmp[0];
+			break;
+		case CP_SIZE:
+			i = (cmp[2] != 0) ? cmp[2] : cmp[0];
+			break;
+		case CP_FPS:
+		default:
+			i = (cmp[0] != 0) ? cmp[0] : cmp[1];
+			break;
+	}
+	/* otherwise the cheapest format to convert */
+	if(i > 0 || (i == 0 && candidate->cost < best->cost))
+		*best = *candidate;
+}
+
+static void _negotiate_intervals(Camera * camera, CameraMode * candidate,
+		CameraMode * best, gboolean * found)
+{
+	struct v4l2_frmivalenum ival;
+
+	memset(&ival, 0, sizeof(ival));
+	ival.pixel_format = candidate->pixelformat;
+	ival.width = candidate->width;
+	ival.height = candidate->height;
+	if(_camera_ioctl(camera, VIDIOC_ENUM_FRAMEINTERVALS, &ival) == -1)
+	{
+		/* the frame rate is unknown */
+		candidate->interval.numerator = 0;
+		candidate->interval.denominator = 0;
+		_negotiate_candidate(camera, candidate, best, found);
+	}
+	else if(ival.type == V4L2_FRMIVAL_TYPE_DISCRETE)
+		do
+		{
+			candidate->interval = ival.discrete;
+			_negotiate_candidate(camera, candidate, best, found);
+			ival.index++;
+		}
+		while(_camera_ioctl(camera, VIDIOC_ENUM_FRAMEINTERVALS, &ival)
+				== 0);
+	else
+	{
+		/* the shortest interval is the fastest */
+		candidate->interval = ival.stepwise.min;
+		_negotiate_candidate(camera, candidate, best, found);
+	}
+}
+
+static void _negotiate_sizes(Camera * camera, CameraMode * candidate,
+		CameraMode * best, gboolean * found)
+{
+	struct v4l2_frmsizeenum size;
+	struct v4l2_frmsize_stepwise * step = &size.stepwise;
+
+	memset(&size, 0, sizeof(size));
+	size.pixel_format = candidate->pixelformat;
+	if(_camera_ioctl(camera, VIDIOC_ENUM_FRAMESIZES, &size) == -1)
+	{
+		/* keep the current size */
+		candidate->width = camera->pix.width;
+		candidate->height = camera->pix.height;
+		_negotiate_intervals(camera, candidate, best, found);
+	}
+	else if(size.type == V4L2_FRMSIZE_TYPE_DISCRETE)
+		do
+		{
+			candidate->width = size.discrete.width;
+			candidate->height = size.discrete.height;
+			_negotiate_intervals(camera, candidate, best, found);
+			size.index++;
+		}
+		while(_camera_ioctl(camera, VIDIOC_ENUM_FRAMESIZES, &size)
+				== 0);
+	else
+	{
+		/* the largest size */
+		candidate->width = step->max_width;
+		candidate->height = step->max_height;
+		_negotiate_intervals(camera, candidate, best, found);
+		if(camera->policy != CP_SIZE || step->step_width == 0
+				|| step->step_height == 0)
+			return;
+		/* the size requested, rounded to the steps available */
+		candidate->width = MIN(MAX(camera->policy_width,
+					step->min_width), step->max_width);
+		candidate->width -= (candidate->width - step->min_width)
+			% step->step_width;
+		candidate->height = MIN(MAX(camera->policy_height,
+					step->min_height), step->max_height);
+		candidate->height -= (candidate->height - step->min_height)
+			% step->step_height;
+		_negotiate_intervals(camera, candidate, best, found);
+	}
+}
+
+static int _setup_buffers(Camera * camera, enum v4l2_memory memory)
+{
+	struct v4l2_requestbuffers req;
+	size_t i;
+
+	memset(&req, 0, sizeof(req));
+	if(camera->adaptive && camera->adaptive_cnt > 0)
+		req.count = camera->adaptive_cnt;
+	else
+		req.count = (camera->reqbufs > 0) ? camera->reqbufs
+			: CAMERA_BUFFERS;
+	req.count = MAX(req.count, CAMERA_BUFFERS_MIN);
+	req.type = camera->type;
+	req.memory = memory;
 	if(_camera_ioctl(camera, VIDIOC_REQBUFS, &req) == -1)
 		return -error_set_code(1, "%s: %s", camera->device,
 				_("Could not request buffers"));
 #ifdef DEBUG
 	fprintf(stderr, "DEBUG: %s() frames=%u\n", __func__, req.count);
 #endif
-	if(req.count < 2)
+	if(req.count < CAMERA_BUFFERS_MIN)
 		return -error_set_code(1, "%s: %s", camera->device,
 				_("Could not obtain enough buffers"));
 	/* initialize the buffers */
-	if((camera->buffers = calloc(req.count, sizeof(*camera->buffers)))
-			== NULL)
+	if((camera->buffers = calloc(req.count * camera->planes_cnt,
+					sizeof(*camera->buffers))) == NULL)
 		return -error_set_code(1, "%s: %s", camera->device,
 				_("Could not allocate buffers"));
 	camera->buffers_cnt = req.count;
+	camera->streaming = TRUE;
+	camera->memory = memory;
+	for(i = 0; i < camera->buffers_cnt * camera->planes_cnt; i++)
+		camera->buffers[i].fd = -1;
+	return 0;
+}
+
+static void _setup_events(Camera * camera)
+{
+#ifdef V4L2_EVENT_SOURCE_CHANGE
+	struct v4l2_event_subscription sub;
+
+	/* optional, as only some drivers report them */
+	memset(&sub, 0, sizeof(sub));
+	sub.type = V4L2_EVENT_SOURCE_CHANGE;
+	camera->events = (_camera_ioctl(camera, VIDIOC_SUBSCRIBE_EVENT, &sub)
+			== 0) ? TRUE : FALSE;
+	memset(&sub, 0, sizeof(sub));
+	sub.type = V4L2_EVENT_EOS;
+	if(_camera_ioctl(camera, VIDIOC_SUBSCRIBE_EVENT, &sub) == 0)
+		camera->events = TRUE;
+#else
+	camera->events = FALSE;
+#endif
+}
+
+static int _setup_export(Camera * camera)
+{
+#ifdef VIDIOC_EXPBUF
+	struct v4l2_exportbuffer expbuf;
+	size_t cnt = camera->buffers_cnt * camera->planes_cnt;
+	size_t i;
+
+	for(i = 0; i < cnt; i++)
+	{
+		memset(&expbuf, 0, sizeof(expbuf));
+		expbuf.type = camera->type;
+		expbuf.index = i / camera->planes_cnt;
+		expbuf.plane = i % camera->planes_cnt;
+		expbuf.flags = O_RDONLY | O_CLOEXEC;
+		if(_camera_ioctl(camera, VIDIOC_EXPBUF, &expbuf) != 0)
+			break;
+		camera->buffers[i].fd = expbuf.fd;
+	}
+	if(i == cnt)
+		return 0;
+	/* export every buffer or none */
+	while(i-- > 0)
+	{
+		close(camera->buffers[i].fd);
+		camera->buffers[i].fd = -1;
+	}
+#endif
+	return -error_set_code(1, "%s: %s", camera->device,
+			_("Could not export buffers"));
+}
+
+static int _setup_stream(Camera * camera)
+{
+	size_t i;
+	enum v4l2_buf_type type = camera->type;
+
 	for(i = 0; i < camera->buffers_cnt; i++)
+		if(_capture_enqueue(camera, i) != 0)
+			return -error_set_code(1, "%s: %s", camera->device,
+					_("Could not queue buffers"));
+	/* start the stream */
+	if(_camera_ioctl(camera, VIDIOC_STREAMON, &type) == -1)
+		return -error_set_code(1, "%s: %s", camera->device,
+				_("Could not start the stream"));
+	/* keep at least one buffer queued in the device */
+	camera->ready_max = camera->buffers_cnt - 2;
+	return 0;
+}
+
+static int _open_setup_mmap(Camera * camera)
+{
+	int ret;
+	size_t i;
+	size_t j;
+	struct v4l2_buffer buf;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+#endif
+	CameraBuffer * buffer;
+	size_t length;
+	off_t offset;
+
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s()\n", __func__);
+#endif
+	/* memory mapping support */
+	if((ret = _setup_buffers(camera, V4L2_MEMORY_MMAP)) != 0)
+		return ret;
+	for(i = 0; i < camera->buffers_cnt * camera->planes_cnt; i++)
 		camera->buffers[i].start = MAP_FAILED;
 	/* map the buffers */
 	for(i = 0; i < camera->buffers_cnt; i++)
 	{
 		memset(&buf, 0, sizeof(buf));
-		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.type = camera->type;
 		buf.memory = V4L2_MEMORY_MMAP;
 		buf.index = i;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+		if(camera->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+		{
+			memset(planes, 0, sizeof(planes));
+			buf.m.planes = planes;
+			buf.length = camera->planes_cnt;
+		}
+#endif
 		if(_camera_ioctl(camera, VIDIOC_QUERYBUF, &buf) == -1)
 			return -error_set_code(1, "%s: %s", camera->device,
 					_("Could not setup buffers"));
-		camera->buffers[i].start = mmap(NULL, buf.length,
-				PROT_READ | PROT_WRITE, MAP_SHARED, camera->fd,
-				buf.m.offset);
-		if(camera->buffers[i].start == MAP_FAILED)
-			return -error_set_code(1, "%s: %s", camera->device,
-					_("Could not map buffers"));
-		camera->buffers[i].length = buf.length;
+		buffer = &camera->buffers[i * camera->planes_cnt];
+		for(j = 0; j < camera->planes_cnt; j++)
+		{
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+			if(camera->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+			{
+				length = planes[j].length;
+				offset = planes[j].m.mem_offset;
+			}
+			else
+#endif
+			{
+				length = buf.length;
+				offset = buf.m.offset;
+			}
+			buffer[j].start = mmap(NULL, length,
+					PROT_READ | PROT_WRITE, MAP_SHARED,
+					camera->fd, offset);
+			if(buffer[j].start == MAP_FAILED)
+				return -error_set_code(1, "%s: %s",
+						camera->device,
+						_("Could not map buffers"));
+			buffer[j].length = length;
+		}
 	}
-	for(i = 0; i < camera->buffers_cnt; i++)
+	/* capture the frames anyway, without sharing them */
+	if(camera->export && _setup_export(camera) != 0)
 	{
-		memset(&camera->buf, 0, sizeof(camera->buf));
-		camera->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		camera->buf.memory = V4L2_MEMORY_MMAP;
-		camera->buf.index = i;
-		if(_camera_ioctl(camera, VIDIOC_QBUF, &camera->buf) == -1)
-			return -error_set_code(1, "%s: %s", camera->device,
-					_("Could not queue buffers"));
+		camera->export = FALSE;
+		_camera_error(camera, error_get(NULL), 1);
 	}
-	/* start the stream */
-	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	if(_camera_ioctl(camera, VIDIOC_STREAMON, &type) == -1)
-		return -error_set_code(1, "%s: %s", camera->device,
-				_("Could not start the stream"));
-	/* allocate the RGB buffer */
-	cnt = camera->format.fmt.pix.width * camera->format.fmt.pix.height * 3;
-	if((p = realloc(camera->rgb_buffer, cnt)) == NULL)
-		return error_set_code(-errno, "%s: %s", camera->device,
-				strerror(errno));
-	camera->rgb_buffer = (unsigned char *)p;
-	camera->rgb_buffer_cnt = cnt;
-	return 0;
+	return _setup_stream(camera);
 }
 
 static int _open_setup_read(Camera * camera)
 {
+	size_t i;
 	size_t cnt;
-	char * p;
 
 #ifdef DEBUG
 	fprintf(stderr, "DEBUG: %s()\n", __func__);
 #endif
-	/* FIXME also try to obtain a RGB24 format if possible */
-	/* allocate the raw buffer */
-	cnt = camera->format.fmt.pix.sizeimage;
-	if((p = realloc(camera->raw_buffer, cnt)) == NULL)
+	/* the planes would have to be contiguous */
+	if(camera->planes_cnt != 1)
+		return -error_set_code(1, "%s: %s", camera->device,
+				_("Unsupported capabilities"));
+	/* allocate the raw buffers */
+	cnt = (camera->reqbufs >= CAMERA_BUFFERS_MIN) ? camera->reqbufs
+		: CAMERA_READ_BUFFERS;
+	if((camera->buffers = calloc(cnt, sizeof(*camera->buffers))) == NULL)
+		return error_set_code(-errno, "%s: %s", camera->device,
+				strerror(errno));
+	camera->buffers_cnt = cnt;
+	cnt = camera->pix.sizeimage;
+	for(i = 0; i < camera->buffers_cnt; i++)
+	{
+		camera->buffers[i].fd = -1;
+		if((camera->buffers[i].start = malloc(cnt)) == NULL)
+			return error_set_code(-errno, "%s: %s", camera->device,
+					strerror(errno));
+		camera->buffers[i].length = cnt;
+	}
+	camera->ready_max = camera->buffers_cnt - 1;
+	return 0;
+}
+
+static int _open_setup_source(Camera * camera)
+{
+	CameraSourceFormat format;
+	struct v4l2_format v4l2;
+	int ret;
+
+	if((camera->input = camerasource_new(camera->device)) == NULL)
+		return -1;
+	camerasource_set_realtime(camera->input, camera->realtime);
+	camerasource_get_format(camera->input, &format);
+	/* present it as a device to read from */
+	memset(&camera->cap, 0, sizeof(camera->cap));
+	snprintf((char *)camera->cap.driver, sizeof(camera->cap.driver), "%s",
+			camerasource_get_name(camera->input));
+	snprintf((char *)camera->cap.card, sizeof(camera->cap.card), "%s",
+			camera->device);
+	camera->cap.capabilities = V4L2_CAP_VIDEO_CAPTURE
+		| V4L2_CAP_READWRITE;
+	camera->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	memset(&v4l2, 0, sizeof(v4l2));
+	v4l2.type = camera->type;
+	v4l2.fmt.pix.pixelformat = format.fourcc;
+	v4l2.fmt.pix.width = format.width;
+	v4l2.fmt.pix.height = format.height;
+	v4l2.fmt.pix.field = V4L2_FIELD_NONE;
+	v4l2.fmt.pix.bytesperline = format.stride;
+	v4l2.fmt.pix.sizeimage = format.size;
+	_setup_format(camera, &v4l2);
+	if((ret = _open_setup_read(camera)) != 0)
+		return ret;
+	_camera_apply_rate(camera);
+	return _open_setup_thread(camera);
+}
+
+static int _open_setup_thread(Camera * camera)
+{
+	size_t i;
+	GError * error = NULL;
+
+	/* allocate the frame queues */
+	if((camera->ready = calloc(camera->buffers_cnt,
+					sizeof(*camera->ready))) == NULL
+			|| (camera->done = calloc(camera->buffers_cnt,
+					sizeof(*camera->done))) == NULL)
 		return error_set_code(-errno, "%s: %s", camera->device,
 				strerror(errno));
-	camera->raw_buffer = p;
-	camera->raw_buffer_cnt = cnt;
-	/* allocate the RGB buffer */
-	cnt = camera->format.fmt.pix.width * camera->format.fmt.pix.height * 3;
-	if((p = realloc(camera->rgb_buffer, cnt)) == NULL)
+	camera->ready_cnt = 0;
+	camera->done_cnt = 0;
+	camera->frames = 0;
+	camera->dropped = 0;
+	camera->adaptive_frames = 0;
+	camera->adaptive_dropped = 0;
+	/* bound the frames waiting to be rendered */
+	if(camera->lowlatency)
+		camera->ready_max = 1;
+	else if(camera->queue > 0 && (size_t)camera->queue < camera->ready_max)
+		camera->ready_max = camera->queue;
+	if(!camera->streaming)
+		/* every buffer is available for reading */
+		for(i = 0; i < camera->buffers_cnt; i++)
+			camera->done[camera->done_cnt++] = i;
+	/* wake the capture thread up when necessary, without ever blocking */
+	if(pipe(camera->wakeup) != 0
+			|| fcntl(camera->wakeup[0], F_SETFL, O_NONBLOCK) != 0
+			|| fcntl(camera->wakeup[1], F_SETFL, O_NONBLOCK) != 0)
 		return error_set_code(-errno, "%s: %s", camera->device,
 				strerror(errno));
-	camera->rgb_buffer = (unsigned char *)p;
-	camera->rgb_buffer_cnt = cnt;
+	/* start capturing */
+	camera->running = TRUE;
+	if((camera->thread = g_thread_try_new(PROGNAME_CAMERA,
+					_camera_capture, camera, &error))
+			== NULL)
+	{
+		camera->running = FALSE;
+		error_set_code(1, "%s: %s", camera->device, error->message);
+		g_error_free(error);
+		return -1;
+	}
 	return 0;
 }
 
+static int _open_setup_userptr(Camera * camera)
+{
+	int ret;
+	size_t i;
+	size_t j;
+	CameraBuffer * buffer;
+	size_t length;
+
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s()\n", __func__);
+#endif
+	/* user pointer support */
+	if((ret = _setup_buffers(camera, V4L2_MEMORY_USERPTR)) != 0)
+		return ret;
+	/* page-aligned memory from the pool */
+	for(i = 0; i < camera->buffers_cnt; i++)
+	{
+		buffer = &camera->buffers[i * camera->planes_cnt];
+		for(j = 0; j < camera->planes_cnt; j++)
+		{
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+			if(camera->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+				length = camera->format.fmt.pix_mp.plane_fmt[j]
+					.sizeimage;
+			else
+#endif
+				length = camera->pix.sizeimage;
+			if(length == 0)
+				return -error_set_code(1, "%s: %s",
+						camera->device,
+						_("Could not setup buffers"));
+			if((buffer[j].start = camerapool_alloc(camera->pool,
+							length,
+							camera->hugepages))
+					== NULL)
+				return -error_set_code(1, "%s: %s",
+						camera->device,
+						_("Could not allocate buffers"));
+			buffer[j].length = length;
+		}
+	}
+	return _setup_stream(camera);
+}
+
+
+/* camera_start_buffers */
+static int _camera_start_buffers(Camera * camera)
+{
+	/* the pools keep the memory for buffers of the same size */
+	if(_open_setup_capture(camera) == 0)
+		return 0;
+	_camera_error(camera, error_get(NULL), 1);
+	_camera_free_buffers(camera);
+	close(camera->fd);
+	camera->fd = -1;
+	return -1;
+}
+
+
+/* camera_stop_buffers */
+static void _camera_stop_buffers(Camera * camera)
+{
+	struct v4l2_requestbuffers req;
+	const gboolean streaming = camera->streaming;
+
+	/* keep the device open, as well as the overlays and dialogs */
+	_camera_stop_capture(camera);
+	memset(&req, 0, sizeof(req));
+	req.type = camera->type;
+	req.memory = camera->memory;
+	_camera_free_buffers(camera);
+	/* release the buffers of the driver as well */
+	if(streaming)
+		_camera_ioctl(camera, VIDIOC_REQBUFS, &req);
+}
+
+
+/* camera_set_mode */
+static void _set_mode_signal(Camera * camera, CameraMode * mode);
+
+static int _camera_set_mode(Camera * camera, CameraMode const * mode)
+{
+	int ret = 0;
+	struct v4l2_format format = camera->format;
+	CameraMode signal;
+
+	_camera_stop_buffers(camera);
+	if(mode == NULL)
+	{
+		/* the size of the input signal changed */
+		_set_mode_signal(camera, &signal);
+		mode = &signal;
+	}
+	if(_setup_mode(camera, mode) == 0)
+	{
+		camera->mode = *mode;
+		camera->mode_valid = TRUE;
+	}
+	else
+	{
+		ret = -error_set_code(1, "%s: %s", camera->device,
+				_("Could not set the video capture format"));
+		/* go back to the previous format */
+		if(_camera_ioctl(camera, VIDIOC_S_FMT, &format) == 0)
+			_setup_format(camera, &format);
+	}
+	if(_camera_start_buffers(camera) != 0)
+		return -1;
+	return ret;
+}
+
+static void _set_mode_signal(Camera * camera, CameraMode * mode)
+{
+#ifdef VIDIOC_QUERY_DV_TIMINGS
+	struct v4l2_dv_timings timings;
+#endif
+	struct v4l2_format format;
+
+#ifdef VIDIOC_QUERY_DV_TIMINGS
+	/* digital video receivers need to be told about the new timings */
+	memset(&timings, 0, sizeof(timings));
+	if(_camera_ioctl(camera, VIDIOC_QUERY_DV_TIMINGS, &timings) == 0)
+		/* XXX ignore errors */
+		_camera_ioctl(camera, VIDIOC_S_DV_TIMINGS, &timings);
+#endif
+	/* keep the pixel format, at the new size */
+	memset(mode, 0, sizeof(*mode));
+	mode->pixelformat = camera->pix.pixelformat;
+	mode->cost = _camera_convert_cost(mode->pixelformat);
+	mode->width = camera->pix.width;
+	mode->height = camera->pix.height;
+	memset(&format, 0, sizeof(format));
+	format.type = camera->type;
+	if(_camera_ioctl(camera, VIDIOC_G_FMT, &format) != 0)
+		return;
+#ifdef V4L2_CAP_VIDEO_CAPTURE_MPLANE
+	if(format.type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+	{
+		mode->width = format.fmt.pix_mp.width;
+		mode->height = format.fmt.pix_mp.height;
+	}
+	else
+#endif
+	{
+		mode->width = format.fmt.pix.width;
+		mode->height = format.fmt.pix.height;
+	}
+}
+
 
 #ifdef EMBEDDED
 /* camera_on_preferences */
@@ -1743,29 +3589,125 @@ static void _camera_on_properties(gpointer data)
 
 
 /* camera_on_refresh */
-static void _refresh_convert(Camera * camera);
-static void _refresh_convert_yuv(int amp, uint8_t y, uint8_t u, uint8_t v,
-		uint8_t * r, uint8_t * g, uint8_t * b);
-static void _refresh_hflip(Camera * camera, GdkPixbuf ** pixbuf);
+static gboolean _refresh_adapt(Camera * camera);
+static void _refresh_borders(Camera * camera, GdkRectangle * rect);
+static void _refresh_error(Camera * camera);
+#if GTK_CHECK_VERSION(3, 0, 0)
+static int _refresh_frame(Camera * camera, int width, int height);
+#endif
+static int _refresh_fused(Camera * camera, GdkRectangle * rect);
+static void _refresh_paint(Camera * camera);
+static void _refresh_pixbuf(Camera * camera, GdkRectangle * rect);
+static void _refresh_render(Camera * camera, gboolean latest);
+static unsigned int _refresh_shrink(Camera * camera);
+static void _refresh_flip(Camera * camera, GdkPixbuf * pixbuf);
 static void _refresh_overlays(Camera * camera, GdkPixbuf * pixbuf);
-static void _refresh_scale(Camera * camera, GdkPixbuf ** pixbuf);
-static void _refresh_vflip(Camera * camera, GdkPixbuf ** pixbuf);
+#if GTK_CHECK_VERSION(3, 0, 0)
+static void _refresh_transform(Camera * camera, cairo_t * cr, int width,
+		int height, GdkRectangle * rect, gboolean flip);
+#else
+static void _refresh_scale(Camera * camera, GdkPixbuf ** pixbuf,
+		GdkRectangle * rect);
+#endif
 
 static gboolean _camera_on_refresh(gpointer data)
 {
 	Camera * camera = data;
-#if GTK_CHECK_VERSION(3, 0, 0)
-	cairo_t * cr;
-	GtkAllocation * allocation = &camera->area_allocation;
-#endif
-	int width = camera->format.fmt.pix.width;
-	int height = camera->format.fmt.pix.height;
+	gboolean error;
 
 #ifdef DEBUG
 	fprintf(stderr, "DEBUG: %s() 0x%x\n", __func__,
-			camera->format.fmt.pix.pixelformat);
+			camera->pix.pixelformat);
+#endif
+	g_mutex_lock(&camera->mutex);
+	camera->refresh = 0;
+	error = (camera->error != NULL) ? TRUE : FALSE;
+	g_mutex_unlock(&camera->mutex);
+	if(error)
+		_refresh_error(camera);
+	else if(camera->visible == FALSE)
+		/* keep the most recent frame for snapshots */
+		_refresh_render(camera, TRUE);
+#if GTK_CHECK_VERSION(3, 8, 0)
+	/* the frames captured meanwhile are not converted at all */
+	else if(camera->tick == 0)
+		camera->tick = gtk_widget_add_tick_callback(camera->area,
+				_camera_on_tick, camera, NULL);
+#else
+	else
+		_refresh_render(camera, camera->lowlatency);
 #endif
-	_refresh_convert(camera);
+	return FALSE;
+}
+
+static void _refresh_render(Camera * camera, gboolean latest)
+{
+	size_t index;
+
+	/* obtain the oldest frame captured */
+	g_mutex_lock(&camera->mutex);
+	if(camera->ready_cnt == 0)
+	{
+		g_mutex_unlock(&camera->mutex);
+		return;
+	}
+	if(latest && camera->ready_cnt > 1)
+	{
+		/* drop every frame but the most recent */
+		memcpy(&camera->done[camera->done_cnt], camera->ready,
+				sizeof(*camera->ready)
+				* (camera->ready_cnt - 1));
+		camera->done_cnt += camera->ready_cnt - 1;
+		camera->ready[0] = camera->ready[camera->ready_cnt - 1];
+		camera->ready_cnt = 1;
+	}
+	index = camera->ready[0];
+	memmove(camera->ready, &camera->ready[1], --camera->ready_cnt
+			* sizeof(*camera->ready));
+	/* give the previous frame back to the capture thread */
+	if(camera->raw_buffer != NULL && camera->raw_buffer->refs > 0)
+		/* once released by every consumer */
+		camera->held_cnt++;
+	else if(camera->raw_buffer != NULL)
+		camera->done[camera->done_cnt++] = camera->raw_index;
+	camera->raw_buffer = &camera->buffers[index * camera->planes_cnt];
+	camera->raw_index = index;
+	g_mutex_unlock(&camera->mutex);
+	/* no pixel work while the frame cannot be seen */
+	if(camera->visible)
+		_refresh_paint(camera);
+	if(_refresh_adapt(camera))
+	{
+		/* restart with the new number of buffers */
+		_camera_stop_buffers(camera);
+		_camera_start_buffers(camera);
+		return;
+	}
+	g_mutex_lock(&camera->mutex);
+	if(camera->ready_cnt > 0 && camera->refresh == 0)
+		camera->refresh = g_idle_add(_camera_on_refresh, camera);
+	g_mutex_unlock(&camera->mutex);
+	if(write(camera->wakeup[1], "", 1) != 1 && errno != EAGAIN)
+		_camera_error(NULL, strerror(errno), 1);
+}
+
+static void _refresh_paint(Camera * camera)
+{
+#if GTK_CHECK_VERSION(3, 0, 0)
+	cairo_t * cr;
+#endif
+	GtkAllocation * allocation = &camera->area_allocation;
+	int width = camera->pix.width;
+	int height = camera->pix.height;
+	GdkRectangle rect;
+
+	/* recycle the last frame rendered */
+	camerapool_put(camera->pool, camera->pixbuf);
+	camera->pixbuf = NULL;
+	_camera_letterbox(camera, &rect);
+	if(rect.width <= 0 || rect.height <= 0)
+		return;
+	_refresh_borders(camera, &rect);
 	if(camera->hflip == FALSE
 			&& camera->vflip == FALSE
 			&& width == allocation->width
@@ -1774,124 +3716,349 @@ static gboolean _camera_on_refresh(gpointer data)
 	{
 		/* render directly */
 #if GTK_CHECK_VERSION(3, 0, 0)
-		cr = cairo_create(camera->surface);
-		camera->pixbuf = gdk_pixbuf_new_from_data(camera->rgb_buffer,
-				GDK_COLORSPACE_RGB, FALSE, 8, width, height,
-				width * 3, NULL, NULL);
-		gdk_cairo_set_source_pixbuf(cr, camera->pixbuf, 0.0, 0.0);
-		cairo_paint(cr);
-		cairo_destroy(cr);
+		/* convert straight into the format of cairo */
+		if(_refresh_frame(camera, width, height) == 0)
+		{
+			cairo_surface_flush(camera->frame);
+			/* XXX on errors, paint what is left of the frame */
+			_camera_convert(camera, CCF_XRGB32, 1,
+					cairo_image_surface_get_data(
+						camera->frame),
+					cairo_image_surface_get_stride(
+						camera->frame));
+			cairo_surface_mark_dirty(camera->frame);
+			cr = cairo_create(camera->surface);
+			cairo_set_source_surface(cr, camera->frame, 0.0, 0.0);
+			cairo_paint(cr);
+			cairo_destroy(cr);
+		}
 #else
-		gdk_draw_rgb_image(camera->pixmap, camera->gc, 0, 0,
-				width, height, GDK_RGB_DITHER_NORMAL,
-				camera->rgb_buffer, width * 3);
+		if((camera->pixbuf = camerapool_get(camera->pool, width,
+						height, FALSE)) != NULL
+				&& _camera_convert(camera, CCF_RGB24, 1,
+					gdk_pixbuf_get_pixels(camera->pixbuf),
+					gdk_pixbuf_get_rowstride(
+						camera->pixbuf)) == 0)
+			gdk_draw_rgb_image(camera->pixmap, camera->gc, 0, 0,
+					width, height, GDK_RGB_DITHER_NORMAL,
+					gdk_pixbuf_get_pixels(camera->pixbuf),
+					gdk_pixbuf_get_rowstride(
+						camera->pixbuf));
 #endif
 	}
-	else
+	else if(_refresh_fused(camera, &rect) != 0)
+		/* render while scaling */
+		_refresh_pixbuf(camera, &rect);
+	/* force a refresh */
+	gtk_widget_queue_draw(camera->area);
+}
+
+static gboolean _refresh_adapt(Camera * camera)
+{
+	size_t cnt = camera->buffers_cnt;
+	unsigned long frames;
+	unsigned long dropped;
+
+	/* the buffers cannot be freed while exported */
+	if(camera->adaptive == FALSE || camera->streaming == FALSE
+			|| _camera_exported(camera) > 0)
+		return FALSE;
+	g_mutex_lock(&camera->mutex);
+	frames = camera->frames;
+	dropped = camera->dropped;
+	g_mutex_unlock(&camera->mutex);
+	if(frames < camera->adaptive_frames + CAMERA_ADAPT_FRAMES)
+		return FALSE;
+	camera->adaptive_frames = frames;
+	if(dropped > camera->adaptive_dropped)
 	{
-		/* render after scaling */
-		if(camera->pixbuf != NULL)
-			g_object_unref(camera->pixbuf);
-		camera->pixbuf = gdk_pixbuf_new_from_data(camera->rgb_buffer,
-				GDK_COLORSPACE_RGB, FALSE, 8, width, height,
-				width * 3, NULL, NULL);
-		_refresh_hflip(camera, &camera->pixbuf);
-		_refresh_vflip(camera, &camera->pixbuf);
-		_refresh_scale(camera, &camera->pixbuf);
-		_refresh_overlays(camera, camera->pixbuf);
+		/* the device ran out of buffers */
+		camera->adaptive_dropped = dropped;
+		camera->adaptive_periods = 0;
+		if(cnt >= CAMERA_BUFFERS_MAX)
+			return FALSE;
+		cnt++;
+	}
+	else if(camera->lowlatency
+			&& ++camera->adaptive_periods >= CAMERA_ADAPT_PERIODS
+			&& cnt > CAMERA_BUFFERS_MIN)
+	{
+		/* every buffer less is a frame less of latency */
+		camera->adaptive_periods = 0;
+		cnt--;
+	}
+	else
+		return FALSE;
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s() %zu => %zu buffers\n", __func__,
+			camera->buffers_cnt, cnt);
+#endif
+	camera->adaptive_cnt = cnt;
+	return TRUE;
+}
+
+static void _refresh_borders(Camera * camera, GdkRectangle * rect)
+{
 #if GTK_CHECK_VERSION(3, 0, 0)
-		cr = cairo_create(camera->surface);
-		gdk_cairo_set_source_pixbuf(cr, camera->pixbuf, 0.0, 0.0);
-		cairo_paint(cr);
-		cairo_destroy(cr);
+	cairo_t * cr;
+#else
+	GtkAllocation * allocation = &camera->area_allocation;
+#endif
+
+	/* the borders only change with the size of the frames */
+	if(rect->x == camera->letterbox.x && rect->y == camera->letterbox.y
+			&& rect->width == camera->letterbox.width
+			&& rect->height == camera->letterbox.height)
+		return;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	cr = cairo_create(camera->surface);
+	cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+	cairo_paint(cr);
+	cairo_destroy(cr);
 #else
-		gdk_pixbuf_render_to_drawable(camera->pixbuf, camera->pixmap,
-				camera->gc, 0, 0, 0, 0, -1, -1,
-				GDK_RGB_DITHER_NORMAL, 0, 0);
+	gdk_draw_rectangle(camera->pixmap, camera->gc, TRUE, 0, 0,
+			allocation->width, allocation->height);
 #endif
+	camera->letterbox = *rect;
+}
+
+static void _refresh_error(Camera * camera)
+{
+	char * error;
+
+	/* the dialog may run a main loop of its own */
+	g_mutex_lock(&camera->mutex);
+	error = g_strdup(camera->error);
+	g_mutex_unlock(&camera->mutex);
+	/* the capture thread is gone, release the device as well */
+	_camera_stop_buffers(camera);
+	_camera_error(camera, error, 1);
+	g_free(error);
+	gtk_widget_set_sensitive(GTK_WIDGET(
+				_camera_toolbar[CT_SNAPSHOT].widget), FALSE);
+	gtk_widget_set_sensitive(GTK_WIDGET(
+				_camera_toolbar[CT_GALLERY].widget), FALSE);
+	gtk_widget_set_sensitive(GTK_WIDGET(
+				_camera_toolbar[CT_PROPERTIES].widget), FALSE);
+}
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+static int _refresh_frame(Camera * camera, int width, int height)
+{
+	if(camera->frame != NULL
+			&& (cairo_image_surface_get_width(camera->frame)
+				!= width
+				|| cairo_image_surface_get_height(
+					camera->frame) != height))
+	{
+		cairo_surface_destroy(camera->frame);
+		camera->frame = NULL;
 	}
-	/* force a refresh */
-	gtk_widget_queue_draw(camera->area);
-	/* read from the camera again */
-	if(camera->buffers != NULL)
+	if(camera->frame == NULL)
 	{
-		if(_camera_ioctl(camera, VIDIOC_QBUF, &camera->buf) == -1)
+		camera->frame = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+				width, height);
+		if(cairo_surface_status(camera->frame) != CAIRO_STATUS_SUCCESS)
 		{
-			fprintf(stderr, "%s\n", strerror(errno));
-			_camera_error(camera, _("Could not queue buffer"), 1);
+			cairo_surface_destroy(camera->frame);
+			camera->frame = NULL;
+			return -1;
 		}
-		camera->source = g_io_add_watch(camera->channel, G_IO_IN,
-				_camera_on_can_mmap, camera);
 	}
-	else
-		camera->source = g_io_add_watch(camera->channel, G_IO_IN,
-				_camera_on_can_read, camera);
-	return FALSE;
+	return 0;
 }
+#endif
 
-static void _refresh_convert(Camera * camera)
+static int _refresh_fused(Camera * camera, GdkRectangle * rect)
 {
-	size_t i;
-	size_t j;
+	struct v4l2_pix_format * pix = &camera->pix;
+	CameraConvertFormat format = CCF_RGB24;
+	CameraConvertInterp interp;
+	CameraConvertFlip flip = CCFL_NONE;
+	CameraConvertPlane planes[CAMERACONVERT_PLANES_MAX];
+	unsigned char * dst;
+	size_t dst_stride;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	cairo_t * cr;
+#endif
 
-	switch(camera->format.fmt.pix.pixelformat)
+	/* the other combinations are left to cairo or gdk-pixbuf */
+	if(_camera_planes(camera, planes) == 0)
+		return -1;
+	switch(camera->interp)
 	{
-		case V4L2_PIX_FMT_YUYV:
-			for(i = 0, j = 0; i + 3 < camera->raw_buffer_cnt;
-					i += 4, j += 6)
-			{
-				/* pixel 0 */
-				_refresh_convert_yuv(camera->yuv_amp,
-						camera->raw_buffer[i],
-						camera->raw_buffer[i + 1],
-						camera->raw_buffer[i + 3],
-						&camera->rgb_buffer[j + 2],
-						&camera->rgb_buffer[j + 1],
-						&camera->rgb_buffer[j]);
-				/* pixel 1 */
-				_refresh_convert_yuv(camera->yuv_amp,
-						camera->raw_buffer[i + 2],
-						camera->raw_buffer[i + 1],
-						camera->raw_buffer[i + 3],
-						&camera->rgb_buffer[j + 5],
-						&camera->rgb_buffer[j + 4],
-						&camera->rgb_buffer[j + 3]);
-			}
+		case GDK_INTERP_NEAREST:
+			interp = CCI_NEAREST;
+			break;
+		case GDK_INTERP_TILES:
+			interp = CCI_AREA;
+			break;
+		case GDK_INTERP_BILINEAR:
+			interp = CCI_BILINEAR;
 			break;
 		default:
-#ifdef DEBUG
-			fprintf(stderr, "DEBUG: %s() Unsupported format\n",
-					__func__);
+			return -1;
+	}
+	if(camera->hflip)
+		flip |= CCFL_HORIZONTAL;
+	if(camera->vflip)
+		flip |= CCFL_VERTICAL;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	if(camera->overlays_cnt == 0)
+	{
+		/* convert straight into the format of cairo */
+		if(_refresh_frame(camera, rect->width, rect->height) != 0)
+			return -1;
+		cairo_surface_flush(camera->frame);
+		format = CCF_XRGB32;
+		dst = cairo_image_surface_get_data(camera->frame);
+		dst_stride = cairo_image_surface_get_stride(camera->frame);
+	}
+	else
 #endif
-			break;
+	{
+		if((camera->pixbuf = camerapool_get(camera->pool,
+						rect->width, rect->height,
+						FALSE)) == NULL)
+			return -1;
+		dst = gdk_pixbuf_get_pixels(camera->pixbuf);
+		dst_stride = gdk_pixbuf_get_rowstride(camera->pixbuf);
+	}
+	if(cameraconvert_frame_scale(camera->convert, pix->pixelformat,
+				format, interp, flip, planes, pix->width,
+				pix->height, dst, dst_stride, rect->width,
+				rect->height) != 0)
+	{
+		camerapool_put(camera->pool, camera->pixbuf);
+		camera->pixbuf = NULL;
+		return -1;
+	}
+#if GTK_CHECK_VERSION(3, 0, 0)
+	if(format == CCF_XRGB32)
+	{
+		cairo_surface_mark_dirty(camera->frame);
+		cr = cairo_create(camera->surface);
+		cairo_set_source_surface(cr, camera->frame, rect->x, rect->y);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+		return 0;
+	}
+#endif
+	_refresh_overlays(camera, camera->pixbuf);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	cr = cairo_create(camera->surface);
+	gdk_cairo_set_source_pixbuf(cr, camera->pixbuf, rect->x, rect->y);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+#else
+	gdk_pixbuf_render_to_drawable(camera->pixbuf, camera->pixmap,
+			camera->gc, 0, 0, rect->x, rect->y, -1, -1,
+			GDK_RGB_DITHER_NORMAL, 0, 0);
+#endif
+	return 0;
+}
+
+static void _refresh_pixbuf(Camera * camera, GdkRectangle * rect)
+{
+	unsigned int shrink;
+	int width;
+	int height;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	cairo_t * cr;
+#endif
+
+	/* decode compressed frames directly at a smaller size if possible */
+	shrink = _refresh_shrink(camera);
+	width = (camera->pix.width + shrink - 1) / shrink;
+	height = (camera->pix.height + shrink - 1) / shrink;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	if(camera->overlays_cnt == 0)
+	{
+		/* convert straight into the format of cairo */
+		if(_refresh_frame(camera, width, height) != 0)
+			return;
+		cairo_surface_flush(camera->frame);
+		if(_camera_convert(camera, CCF_XRGB32, shrink,
+					cairo_image_surface_get_data(
+						camera->frame),
+					cairo_image_surface_get_stride(
+						camera->frame)) != 0)
+			/* do not render this frame */
+			return;
+		cairo_surface_mark_dirty(camera->frame);
+		cr = cairo_create(camera->surface);
+		cairo_set_source_surface(cr, camera->frame, 0.0, 0.0);
+		_refresh_transform(camera, cr, width, height, rect, TRUE);
+		cairo_destroy(cr);
+		return;
+	}
+#endif
+	if((camera->pixbuf = camerapool_get(camera->pool, width, height,
+					FALSE)) == NULL)
+		return;
+	if(_camera_convert(camera, CCF_RGB24, shrink,
+				gdk_pixbuf_get_pixels(camera->pixbuf),
+				gdk_pixbuf_get_rowstride(camera->pixbuf)) != 0)
+	{
+		/* do not render this frame */
+		camerapool_put(camera->pool, camera->pixbuf);
+		camera->pixbuf = NULL;
+		return;
 	}
+	_refresh_flip(camera, camera->pixbuf);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	_refresh_overlays(camera, camera->pixbuf);
+	cr = cairo_create(camera->surface);
+	gdk_cairo_set_source_pixbuf(cr, camera->pixbuf, 0.0, 0.0);
+	_refresh_transform(camera, cr, width, height, rect, FALSE);
+	cairo_destroy(cr);
+#else
+	_refresh_scale(camera, &camera->pixbuf, rect);
+	_refresh_overlays(camera, camera->pixbuf);
+	gdk_pixbuf_render_to_drawable(camera->pixbuf, camera->pixmap,
+			camera->gc, 0, 0, rect->x, rect->y, -1, -1,
+			GDK_RGB_DITHER_NORMAL, 0, 0);
+#endif
 }
 
-static void _refresh_convert_yuv(int amp, uint8_t y, uint8_t u, uint8_t v,
-		uint8_t * r, uint8_t * g, uint8_t * b)
+static unsigned int _refresh_shrink(Camera * camera)
 {
-	double dr;
-	double dg;
-	double db;
+	struct v4l2_pix_format * pix = &camera->pix;
+	GdkRectangle rect;
 
-	dr = amp * (0.004565 * y + 0.007935 * u - 1.088);
-	dg = amp * (0.004565 * y - 0.001542 * u - 0.003183 * v + 0.531);
-	db = amp * (0.004565 * y + 0.000001 * u + 0.006250 * v - 0.872);
-	*r = (dr < 0) ? 0 : ((dr > 255) ? 255 : dr);
-	*g = (dg < 0) ? 0 : ((dg > 255) ? 255 : dg);
-	*b = (db < 0) ? 0 : ((db > 255) ? 255 : db);
+	switch(pix->pixelformat)
+	{
+		case V4L2_PIX_FMT_JPEG:
+		case V4L2_PIX_FMT_MJPEG:
+			break;
+		default:
+			return 1;
+	}
+	_camera_letterbox(camera, &rect);
+	if(rect.width <= 0 || rect.height <= 0)
+		return 1;
+	return cameradecode_mjpeg_shrink(pix->width, pix->height, rect.width,
+			rect.height);
 }
 
-static void _refresh_hflip(Camera * camera, GdkPixbuf ** pixbuf)
+static void _refresh_flip(Camera * camera, GdkPixbuf * pixbuf)
 {
-	GdkPixbuf * pixbuf2;
+	CameraConvertFlip flip = CCFL_NONE;
 
-	if(camera->hflip == FALSE)
+	if(camera->hflip)
+		flip |= CCFL_HORIZONTAL;
+	if(camera->vflip)
+		flip |= CCFL_VERTICAL;
+	if(flip == CCFL_NONE)
 		return;
-	/* XXX could probably be more efficient */
-	pixbuf2 = gdk_pixbuf_flip(*pixbuf, TRUE);
-	g_object_unref(*pixbuf);
-	*pixbuf = pixbuf2;
+	/* both at once amount to a rotation, done in a single pass */
+	cameraconvert_flip(camera->convert,
+			(gdk_pixbuf_get_n_channels(pixbuf) == 4)
+			? CCF_XRGB32 : CCF_RGB24, flip,
+			gdk_pixbuf_get_pixels(pixbuf),
+			gdk_pixbuf_get_rowstride(pixbuf),
+			gdk_pixbuf_get_width(pixbuf),
+			gdk_pixbuf_get_height(pixbuf));
 }
 
 static void _refresh_overlays(Camera * camera, GdkPixbuf * pixbuf)
@@ -1902,64 +4069,78 @@ static void _refresh_overlays(Camera * camera, GdkPixbuf * pixbuf)
 		cameraoverlay_blit(camera->overlays[i], pixbuf);
 }
 
-static void _refresh_scale(Camera * camera, GdkPixbuf ** pixbuf)
+#if GTK_CHECK_VERSION(3, 0, 0)
+static void _refresh_transform(Camera * camera, cairo_t * cr, int width,
+		int height, GdkRectangle * rect, gboolean flip)
 {
-	GtkAllocation * allocation = &camera->area_allocation;
-	GdkPixbuf * pixbuf2;
-	gdouble scale;
-	gint width;
-	gint height;
-	gint x;
-	gint y;
-
-	if(allocation->width > 0 && allocation->height > 0
-			&& (uint32_t)allocation->width
-			== camera->format.fmt.pix.width
-			&& (uint32_t)allocation->height
-			== camera->format.fmt.pix.height)
-		/* no need to scale anything */
-		return;
-	if(camera->ratio == FALSE)
-		pixbuf2 = gdk_pixbuf_scale_simple(*pixbuf, allocation->width,
-				allocation->height, camera->interp);
-	else
+	cairo_pattern_t * pattern = cairo_get_source(cr);
+	cairo_matrix_t matrix;
+	cairo_filter_t filter;
+	gdouble sx = (gdouble)width / rect->width;
+	gdouble sy = (gdouble)height / rect->height;
+
+	/* map the rectangle drawn back onto the frame, mirrored if flipped */
+	cairo_matrix_init(&matrix, sx, 0.0, 0.0, sy, -sx * rect->x,
+			-sy * rect->y);
+	if(flip && camera->hflip)
 	{
-		if((pixbuf2 = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8,
-						allocation->width,
-						allocation->height)) == NULL)
-			/* XXX report errors */
-			return;
-		/* XXX could be more efficient */
-		gdk_pixbuf_fill(pixbuf2, 0);
-		scale = (gdouble)allocation->width
-			/ camera->format.fmt.pix.width;
-		scale = MIN(scale, (gdouble)allocation->height
-				/ camera->format.fmt.pix.height);
-		width = (gdouble)camera->format.fmt.pix.width * scale;
-		width = MIN(width, allocation->width);
-		height = (gdouble)camera->format.fmt.pix.height * scale;
-		height = MIN(height, allocation->height);
-		x = (allocation->width - width) / 2;
-		y = (allocation->height - height) / 2;
-		gdk_pixbuf_scale(*pixbuf, pixbuf2, x, y, width, height,
-				0.0, 0.0, scale, scale, camera->interp);
-	}
-	g_object_unref(*pixbuf);
-	*pixbuf = pixbuf2;
+		matrix.xx = -sx;
+		matrix.x0 = width + sx * rect->x;
+	}
+	if(flip && camera->vflip)
+	{
+		matrix.yy = -sy;
+		matrix.y0 = height + sy * rect->y;
+	}
+	switch(camera->interp)
+	{
+		case GDK_INTERP_NEAREST:
+			filter = CAIRO_FILTER_NEAREST;
+			break;
+		case GDK_INTERP_TILES:
+			filter = CAIRO_FILTER_GOOD;
+			break;
+		case GDK_INTERP_HYPER:
+			filter = CAIRO_FILTER_BEST;
+			break;
+		case GDK_INTERP_BILINEAR:
+		default:
+			filter = CAIRO_FILTER_BILINEAR;
+			break;
+	}
+	cairo_pattern_set_matrix(pattern, &matrix);
+	cairo_pattern_set_filter(pattern, filter);
+	/* do not blend the edges of the frame with the borders */
+	cairo_pattern_set_extend(pattern, CAIRO_EXTEND_PAD);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_rectangle(cr, rect->x, rect->y, rect->width, rect->height);
+	cairo_fill(cr);
 }
+#else
 
-static void _refresh_vflip(Camera * camera, GdkPixbuf ** pixbuf)
+static void _refresh_scale(Camera * camera, GdkPixbuf ** pixbuf,
+		GdkRectangle * rect)
 {
 	GdkPixbuf * pixbuf2;
 
-	if(camera->vflip == FALSE)
+	if(rect->width == gdk_pixbuf_get_width(*pixbuf)
+			&& rect->height == gdk_pixbuf_get_height(*pixbuf))
+		/* no need to scale anything */
+		return;
+	if((pixbuf2 = camerapool_get(camera->pool, rect->width, rect->height,
+					FALSE)) == NULL)
+		/* XXX report errors */
 		return;
-	/* XXX could probably be more efficient */
-	pixbuf2 = gdk_pixbuf_flip(*pixbuf, FALSE);
-	g_object_unref(*pixbuf);
+	/* the frame may have been decoded at a smaller size */
+	gdk_pixbuf_scale(*pixbuf, pixbuf2, 0, 0, rect->width, rect->height,
+			0.0, 0.0,
+			(gdouble)rect->width / gdk_pixbuf_get_width(*pixbuf),
+			(gdouble)rect->height / gdk_pixbuf_get_height(*pixbuf),
+			camera->interp);
+	camerapool_put(camera->pool, *pixbuf);
 	*pixbuf = pixbuf2;
 }
-
+#endif
 
 /* camera_on_snapshot */
 static void _camera_on_snapshot(gpointer data)
@@ -1968,3 +4149,39 @@ static void _camera_on_snapshot(gpointer data)
 
 	camera_snapshot(camera, CSF_DEFAULT);
 }
+
+
+#if GTK_CHECK_VERSION(3, 8, 0)
+/* camera_on_tick */
+static gboolean _camera_on_tick(GtkWidget * widget, GdkFrameClock * clock,
+		gpointer data)
+{
+	Camera * camera = data;
+	(void) widget;
+	(void) clock;
+
+	camera->tick = 0;
+	/* the display cannot show more than a frame per tick */
+	_refresh_render(camera, TRUE);
+	return FALSE;
+}
+#endif
+
+
+/* camera_on_window_state */
+static gboolean _camera_on_window_state(GtkWidget * widget,
+		GdkEventWindowState * event, gpointer data)
+{
+	Camera * camera = data;
+	const GdkWindowState hidden = GDK_WINDOW_STATE_ICONIFIED
+		| GDK_WINDOW_STATE_WITHDRAWN;
+	(void) widget;
+
+	if((event->changed_mask & hidden) == 0)
+		return FALSE;
+	camera->iconified = (event->new_window_state & hidden) ? TRUE : FALSE;
+	_camera_set_visible(camera);
+	if(camera->idlerate > 0)
+		_camera_apply_idle(camera);
+	return FALSE;
+}
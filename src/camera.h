@@ -49,6 +49,29 @@ typedef enum _CameraSnapshotFormat
 # define CSF_LAST CSF_JPEG
 # define CSF_COUNT (CSF_LAST + 1)
 
+/* frames shared as DMABUF file descriptors */
+# define CAMERA_EXPORT_PLANES_MAX	4
+
+typedef struct _CameraExportPlane
+{
+	int fd;
+	size_t offset;
+	size_t size;
+	size_t stride;
+} CameraExportPlane;
+
+typedef struct _CameraExport
+{
+	unsigned int index;
+	/* the set of buffers the frame belongs to */
+	unsigned int generation;
+	unsigned int fourcc;
+	unsigned int width;
+	unsigned int height;
+	unsigned int planes_cnt;
+	CameraExportPlane planes[CAMERA_EXPORT_PLANES_MAX];
+} CameraExport;
+
 
 /* functions */
 Camera * camera_new(GtkWidget * window, GtkAccelGroup * group,
@@ -61,6 +84,8 @@ GtkWidget * camera_get_widget(Camera * camera);
 
 void camera_set_aspect_ratio(Camera * camera, gboolean ratio);
 int camera_set_device(Camera * camera, char const * device);
+/* 0 for the default */
+void camera_set_framerate(Camera * camera, unsigned int framerate);
 void camera_set_hflip(Camera * camera, gboolean flip);
 void camera_set_vflip(Camera * camera, gboolean flip);
 
@@ -77,8 +102,19 @@ int camera_save(Camera * camera);
 
 void camera_start(Camera * camera);
 void camera_stop(Camera * camera);
+/* changes the capture format in place (0 to keep the current value) */
+int camera_reconfigure(Camera * camera, unsigned int pixelformat,
+		unsigned int width, unsigned int height);
 
 CameraOverlay * camera_add_overlay(Camera * camera, char const * filename,
 		int opacity);
 
+/* the file descriptors remain valid until released, or duplicated; the
+ * capture format and the number of buffers are kept meanwhile (following a
+ * change of the input signal waits for the last release), but stopping the
+ * camera or changing the device closes them regardless, and releasing them
+ * afterwards has no effect (duplicates keep the frames alive) */
+int camera_export_acquire(Camera * camera, CameraExport * export);
+void camera_export_release(Camera * camera, CameraExport const * export);
+
 #endif /* !CAMERA_CAMERA_H */
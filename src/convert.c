@@ -0,0 +1,3148 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Camera */
+/* Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ITS AUTHORS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+#include <stddef.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <libintl.h>
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+# include <immintrin.h>
+# define CONVERT_X86
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define CONVERT_NEON
+#endif
+#include <glib.h>
+#include <System.h>
+#include "convert.h"
+#define _(string) gettext(string)
+
+
+/* CameraConvert */
+/* private */
+/* types */
+typedef void (*CameraConvertRow)(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+/* with the chrominance subsampled twice in both directions */
+typedef void (*CameraConvertPlanar)(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width);
+/* exchanges the pixels of a row with those of another, in reverse order
+ * (reverses the row instead when both are the same) */
+typedef void (*CameraConvertReverse)(unsigned char * a, unsigned char * b,
+		unsigned int width);
+/* blends two rows of bytes, the weight of the second out of 256 */
+typedef void (*CameraConvertBlend)(unsigned char const * top,
+		unsigned char const * bottom, unsigned int weight,
+		unsigned char * dst, size_t size);
+/* averages blocks of pixels as wide as the number of rows given */
+typedef void (*CameraConvertDecimate)(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+
+typedef enum _CameraConvertKernel
+{
+	CCK_YUYV = 0,
+	CCK_UYVY,
+	CCK_GREY,
+	CCK_RGB24,
+	CCK_BGR24,
+	CCK_YUV420
+} CameraConvertKernel;
+#define CCK_LAST CCK_YUV420
+#define CCK_COUNT (CCK_LAST + 1)
+
+typedef enum _CameraConvertChroma
+{
+	CCC_NONE = 0,
+	/* U and V in planes of their own */
+	CCC_PLANAR,
+	/* U and V interleaved in the second plane */
+	CCC_INTERLEAVED
+} CameraConvertChroma;
+
+typedef struct _CameraConvertSource
+{
+	uint32_t fourcc;
+	CameraConvertKernel kernel;
+	unsigned int cost;
+	/* bytes per pixel in the first plane */
+	unsigned int bpp;
+	CameraConvertChroma chroma;
+	/* V before U */
+	int swap;
+} CameraConvertSource;
+
+typedef struct _CameraConvertScale
+{
+	CameraConvertFormat format;
+	CameraConvertInterp interp;
+	CameraConvertFlip flip;
+	unsigned int src_width;
+	unsigned int src_height;
+	unsigned int dst_width;
+	unsigned int dst_height;
+
+	/* blocks of pixels averaged directly (2 or 4), if exactly smaller */
+	unsigned int decimate;
+
+	/* source column for every destination column, with its weight (for
+	 * each of the source columns covered with the area filter) */
+	size_t * offset;
+	uint16_t * weight;
+	unsigned int taps;
+
+	/* the same for the rows, with the area filter */
+	unsigned int * row;
+	uint16_t * row_weight;
+	unsigned int row_taps;
+} CameraConvertScale;
+
+typedef struct _CameraConvertBand
+{
+	CameraConvertRow row;
+	CameraConvertPlanar planar;
+	/* luminance or packed pixels, then U and V */
+	CameraConvertPlane plane[CAMERACONVERT_PLANES_MAX];
+	size_t step;
+	unsigned char * dst;
+	size_t dst_stride;
+	unsigned int width;
+	unsigned int height;
+
+	/* the first row of the band, and when scaling its source rows */
+	unsigned int y;
+	CameraConvertScale const * scale;
+	unsigned char * scratch;
+} CameraConvertBand;
+
+struct _CameraConvert
+{
+	int amp;
+
+	/* fixed-point coefficients, with CONVERT_SHIFT bits of fraction */
+	int32_t y[256];
+	int32_t ru[256];
+	int32_t rv[256];
+	int32_t gu[256];
+	int32_t gv[256];
+	int32_t bu[256];
+
+	/* coefficients for the vector kernels (see _convert_vector()) */
+	int vector;
+	int16_t cy;
+	int16_t crv;
+	int16_t cgu;
+	int16_t cgv;
+	int16_t cbu;
+	int16_t kr;
+	int16_t kg;
+	int16_t kb;
+
+	/* kernels selected for this CPU */
+	CameraConvertRow packed[CCK_COUNT][CCF_COUNT];
+	CameraConvertPlanar yuv420[CCF_COUNT];
+	CameraConvertReverse reverse[CCF_COUNT];
+	CameraConvertBlend blend;
+	CameraConvertDecimate decimate2[CCF_COUNT];
+	CameraConvertDecimate decimate4[CCF_COUNT];
+
+	/* scaling, with CONVERT_SCRATCH_ROWS rows per band */
+	CameraConvertScale scale;
+	unsigned char * scratch;
+	size_t scratch_size;
+	size_t scratch_row;
+
+	/* conversion in parallel bands of rows */
+	unsigned int bands;
+	CameraConvertBand * band;
+	GThreadPool * pool;
+	GMutex mutex;
+	GCond cond;
+	unsigned int pending;
+};
+
+
+/* constants */
+#define CONVERT_SHIFT		16
+#define CONVERT_BANDS_MAX	16
+/* minimum number of rows worth a band of its own */
+#define CONVERT_BAND_ROWS	120
+/* bits of fraction in the weights when interpolating */
+#define CONVERT_WEIGHT_SHIFT	8
+/* bits of fraction in the weights of the area filter */
+#define CONVERT_AREA_SHIFT	14
+/* rows of scratch per band: up to four source rows, two scaled rows, then
+ * the sums of the area filter (four bytes per component) */
+#define CONVERT_SCRATCH_SOURCE	0
+#define CONVERT_SCRATCH_SCALED	4
+#define CONVERT_SCRATCH_SUMS	6
+#define CONVERT_SCRATCH_ROWS	10
+
+/* the formats supported, with the cheapest first */
+static const CameraConvertSource _convert_sources[] =
+{
+	{ CAMERACONVERT_FOURCC('R', 'G', 'B', '3'), CCK_RGB24, 1, 3, CCC_NONE,
+		0 },
+	{ CAMERACONVERT_FOURCC('B', 'G', 'R', '3'), CCK_BGR24, 2, 3, CCC_NONE,
+		0 },
+	{ CAMERACONVERT_FOURCC('Y', 'U', 'Y', 'V'), CCK_YUYV, 3, 2, CCC_NONE,
+		0 },
+	{ CAMERACONVERT_FOURCC('U', 'Y', 'V', 'Y'), CCK_UYVY, 3, 2, CCC_NONE,
+		0 },
+	{ CAMERACONVERT_FOURCC('N', 'V', '1', '2'), CCK_YUV420, 3, 1,
+		CCC_INTERLEAVED, 0 },
+	{ CAMERACONVERT_FOURCC('N', 'V', '2', '1'), CCK_YUV420, 3, 1,
+		CCC_INTERLEAVED, 1 },
+	{ CAMERACONVERT_FOURCC('Y', 'U', '1', '2'), CCK_YUV420, 3, 1,
+		CCC_PLANAR, 0 },
+	{ CAMERACONVERT_FOURCC('Y', 'V', '1', '2'), CCK_YUV420, 3, 1,
+		CCC_PLANAR, 1 },
+	/* the same, with every plane captured in a buffer of its own */
+	{ CAMERACONVERT_FOURCC('N', 'M', '1', '2'), CCK_YUV420, 3, 1,
+		CCC_INTERLEAVED, 0 },
+	{ CAMERACONVERT_FOURCC('N', 'M', '2', '1'), CCK_YUV420, 3, 1,
+		CCC_INTERLEAVED, 1 },
+	{ CAMERACONVERT_FOURCC('Y', 'M', '1', '2'), CCK_YUV420, 3, 1,
+		CCC_PLANAR, 0 },
+	{ CAMERACONVERT_FOURCC('Y', 'M', '2', '1'), CCK_YUV420, 3, 1,
+		CCC_PLANAR, 1 },
+	/* the colours are lost */
+	{ CAMERACONVERT_FOURCC('G', 'R', 'E', 'Y'), CCK_GREY, 8, 1, CCC_NONE,
+		0 }
+};
+
+
+/* prototypes */
+static void _convert_select(CameraConvert * convert);
+static void _convert_tables(CameraConvert * convert);
+static void _convert_vector(CameraConvert * convert);
+
+static CameraConvertSource const * _convert_source(uint32_t fourcc);
+
+static void _convert_band(CameraConvert * convert, CameraConvertBand * band);
+static void _convert_bands(CameraConvert * convert, CameraConvertBand * frame);
+static int _convert_frame(CameraConvert * convert, CameraConvertBand * frame,
+		uint32_t fourcc, CameraConvertFormat format,
+		CameraConvertPlane const * planes, unsigned int width,
+		unsigned int * height);
+static void _convert_row(CameraConvert * convert,
+		CameraConvertBand const * band, unsigned int y,
+		unsigned char * dst, unsigned int width);
+static void _convert_rows(CameraConvert * convert, CameraConvertBand * band);
+static int _convert_scale(CameraConvert * convert, CameraConvertFormat format,
+		CameraConvertInterp interp, CameraConvertFlip flip,
+		unsigned int src_width, unsigned int src_height,
+		unsigned int dst_width, unsigned int dst_height);
+static void _convert_scale_rows(CameraConvert * convert,
+		CameraConvertBand * band);
+
+static inline uint8_t _convert_clamp(int32_t value);
+
+static void _convert_yuyv_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuyv_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_uyvy_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_uyvy_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuv420_rgb24(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuv420_xrgb32(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width);
+static void _convert_grey_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_grey_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_rgb24_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_rgb24_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_bgr24_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_bgr24_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_reverse_rgb24(unsigned char * a, unsigned char * b,
+		unsigned int width);
+static void _convert_reverse_xrgb32(unsigned char * a, unsigned char * b,
+		unsigned int width);
+static void _convert_blend(unsigned char const * top,
+		unsigned char const * bottom, unsigned int weight,
+		unsigned char * dst, size_t size);
+static void _convert_decimate2_rgb24(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+static void _convert_decimate2_xrgb32(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+static void _convert_decimate4_rgb24(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+static void _convert_decimate4_xrgb32(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+#ifdef CONVERT_X86
+static void _convert_yuyv_rgb24_sse2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuyv_rgb24_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuyv_rgb24_avx2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuyv_xrgb32_sse2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuyv_xrgb32_avx2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_uyvy_rgb24_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_uyvy_xrgb32_sse2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuv420_rgb24_ssse3(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuv420_xrgb32_sse2(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width);
+static void _convert_rgb24_xrgb32_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_bgr24_rgb24_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_bgr24_xrgb32_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_reverse_rgb24_ssse3(unsigned char * a, unsigned char * b,
+		unsigned int width);
+static void _convert_reverse_xrgb32_sse2(unsigned char * a, unsigned char * b,
+		unsigned int width);
+static void _convert_blend_sse2(unsigned char const * top,
+		unsigned char const * bottom, unsigned int weight,
+		unsigned char * dst, size_t size);
+static void _convert_decimate2_rgb24_ssse3(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+static void _convert_decimate2_xrgb32_sse2(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+static void _convert_decimate4_xrgb32_sse2(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+#endif
+#ifdef CONVERT_NEON
+static void _convert_yuyv_rgb24_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_uyvy_rgb24_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuv420_rgb24_neon(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width);
+static void _convert_bgr24_rgb24_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+# if G_BYTE_ORDER == G_LITTLE_ENDIAN
+static void _convert_yuyv_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_uyvy_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_yuv420_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width);
+static void _convert_rgb24_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+static void _convert_bgr24_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width);
+# endif
+static void _convert_reverse_rgb24_neon(unsigned char * a, unsigned char * b,
+		unsigned int width);
+static void _convert_reverse_xrgb32_neon(unsigned char * a, unsigned char * b,
+		unsigned int width);
+static void _convert_blend_neon(unsigned char const * top,
+		unsigned char const * bottom, unsigned int weight,
+		unsigned char * dst, size_t size);
+static void _convert_decimate2_rgb24_neon(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+static void _convert_decimate2_xrgb32_neon(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+static void _convert_decimate4_rgb24_neon(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+static void _convert_decimate4_xrgb32_neon(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width);
+#endif
+
+
+/* public */
+/* functions */
+/* cameraconvert_new */
+CameraConvert * cameraconvert_new(int amp)
+{
+	CameraConvert * convert;
+
+	if((convert = object_new(sizeof(*convert))) == NULL)
+		return NULL;
+	convert->bands = 1;
+	convert->band = NULL;
+	convert->pool = NULL;
+	g_mutex_init(&convert->mutex);
+	g_cond_init(&convert->cond);
+	convert->pending = 0;
+	memset(&convert->scale, 0, sizeof(convert->scale));
+	convert->scale.offset = NULL;
+	convert->scale.weight = NULL;
+	convert->scale.row = NULL;
+	convert->scale.row_weight = NULL;
+	convert->scratch = NULL;
+	convert->scratch_size = 0;
+	convert->scratch_row = 0;
+	convert->amp = amp;
+	_convert_tables(convert);
+	_convert_vector(convert);
+	_convert_select(convert);
+	return convert;
+}
+
+
+/* cameraconvert_delete */
+void cameraconvert_delete(CameraConvert * convert)
+{
+	if(convert->pool != NULL)
+		g_thread_pool_free(convert->pool, FALSE, TRUE);
+	free(convert->band);
+	free(convert->scale.offset);
+	free(convert->scale.weight);
+	free(convert->scale.row);
+	free(convert->scale.row_weight);
+	free(convert->scratch);
+	g_cond_clear(&convert->cond);
+	g_mutex_clear(&convert->mutex);
+	object_delete(convert);
+}
+
+
+/* accessors */
+/* cameraconvert_get_amp */
+int cameraconvert_get_amp(CameraConvert * convert)
+{
+	return convert->amp;
+}
+
+
+/* cameraconvert_get_bands */
+unsigned int cameraconvert_get_bands(CameraConvert * convert)
+{
+	return convert->bands;
+}
+
+
+/* cameraconvert_set_amp */
+void cameraconvert_set_amp(CameraConvert * convert, int amp)
+{
+	if(convert->amp == amp)
+		return;
+	convert->amp = amp;
+	_convert_tables(convert);
+	_convert_vector(convert);
+	_convert_select(convert);
+}
+
+
+/* cameraconvert_set_bands */
+static void _set_bands_on_band(gpointer data, gpointer user_data);
+
+int cameraconvert_set_bands(CameraConvert * convert, unsigned int bands)
+{
+	CameraConvertBand * band;
+	GError * error = NULL;
+
+	if(bands == 0)
+		/* one band per processor online */
+		bands = g_get_num_processors();
+	if(bands > CONVERT_BANDS_MAX)
+		bands = CONVERT_BANDS_MAX;
+	if(bands == convert->bands && (bands == 1 || convert->pool != NULL))
+		return 0;
+	if(convert->pool != NULL)
+		g_thread_pool_free(convert->pool, FALSE, TRUE);
+	convert->pool = NULL;
+	convert->bands = 1;
+	if(bands == 1)
+		return 0;
+	if((band = realloc(convert->band, sizeof(*band) * bands)) == NULL)
+		return -error_set_code(-errno, "%s", strerror(errno));
+	convert->band = band;
+	/* the calling thread converts the first band itself */
+	if((convert->pool = g_thread_pool_new(_set_bands_on_band, convert,
+					bands - 1, TRUE, &error)) == NULL)
+	{
+		error_set_code(1, "%s", error->message);
+		g_error_free(error);
+		return -1;
+	}
+	convert->bands = bands;
+	return 0;
+}
+
+static void _set_bands_on_band(gpointer data, gpointer user_data)
+{
+	CameraConvertBand * band = data;
+	CameraConvert * convert = user_data;
+
+	_convert_band(convert, band);
+	g_mutex_lock(&convert->mutex);
+	if(--convert->pending == 0)
+		g_cond_signal(&convert->cond);
+	g_mutex_unlock(&convert->mutex);
+}
+
+
+/* useful */
+/* cameraconvert_cost */
+unsigned int cameraconvert_cost(uint32_t fourcc)
+{
+	CameraConvertSource const * source;
+
+	return ((source = _convert_source(fourcc)) != NULL) ? source->cost : 0;
+}
+
+
+/* cameraconvert_flip */
+static void _flip_rows(unsigned char * a, unsigned char * b, size_t size);
+
+void cameraconvert_flip(CameraConvert * convert, CameraConvertFormat format,
+		CameraConvertFlip flip, unsigned char * data, size_t stride,
+		unsigned int width, unsigned int height)
+{
+	CameraConvertReverse reverse = convert->reverse[format];
+	const size_t size = width * ((format == CCF_RGB24) ? 3 : 4);
+	unsigned char * top;
+	unsigned char * bottom;
+	unsigned int y = 0;
+	unsigned int end = height;
+
+	if(flip & CCFL_VERTICAL)
+	{
+		for(; y < height / 2; y++)
+		{
+			top = &data[stride * y];
+			bottom = &data[stride * (height - y - 1)];
+			if(flip & CCFL_HORIZONTAL)
+				/* rotates by 180 degrees in a single pass */
+				reverse(top, bottom, width);
+			else
+				_flip_rows(top, bottom, size);
+		}
+		/* leaves the middle row, if any */
+		end = (height + 1) / 2;
+	}
+	if(flip & CCFL_HORIZONTAL)
+		for(; y < end; y++)
+			reverse(&data[stride * y], &data[stride * y], width);
+}
+
+static void _flip_rows(unsigned char * a, unsigned char * b, size_t size)
+{
+	unsigned char buf[1024];
+	size_t n;
+
+	for(; size > 0; size -= n, a += n, b += n)
+	{
+		n = MIN(size, sizeof(buf));
+		memcpy(buf, a, n);
+		memcpy(a, b, n);
+		memcpy(b, buf, n);
+	}
+}
+
+
+/* cameraconvert_frame */
+int cameraconvert_frame(CameraConvert * convert, uint32_t fourcc,
+		CameraConvertFormat format, CameraConvertPlane const * planes,
+		unsigned int width, unsigned int height,
+		unsigned char * dst, size_t dst_stride)
+{
+	CameraConvertBand frame;
+
+	/* only convert the rows available */
+	if(_convert_frame(convert, &frame, fourcc, format, planes, width,
+				&height) != 0)
+		return -1;
+	if(height == 0)
+		return -error_set_code(1, "%s", _("Empty frame"));
+	frame.dst = dst;
+	frame.dst_stride = dst_stride;
+	frame.width = width;
+	frame.height = height;
+	frame.y = 0;
+	frame.scale = NULL;
+	frame.scratch = NULL;
+	_convert_bands(convert, &frame);
+	return 0;
+}
+
+
+/* cameraconvert_frame_scale */
+int cameraconvert_frame_scale(CameraConvert * convert, uint32_t fourcc,
+		CameraConvertFormat format, CameraConvertInterp interp,
+		CameraConvertFlip flip, CameraConvertPlane const * planes,
+		unsigned int src_width, unsigned int src_height,
+		unsigned char * dst, size_t dst_stride,
+		unsigned int dst_width, unsigned int dst_height)
+{
+	CameraConvertBand frame;
+
+	if(dst_width == 0 || dst_height == 0)
+		return 0;
+	if(_convert_frame(convert, &frame, fourcc, format, planes,
+				src_width, &src_height) != 0)
+		return -1;
+	if(src_width == 0 || src_height == 0)
+		return -error_set_code(1, "%s", _("Empty frame"));
+	if(_convert_scale(convert, format, interp, flip, src_width,
+				src_height, dst_width, dst_height) != 0)
+		return -1;
+	/* every source row is converted once, and only when needed */
+	frame.dst = dst;
+	frame.dst_stride = dst_stride;
+	frame.width = dst_width;
+	frame.height = dst_height;
+	frame.y = 0;
+	frame.scale = &convert->scale;
+	frame.scratch = convert->scratch;
+	_convert_bands(convert, &frame);
+	return 0;
+}
+
+
+/* cameraconvert_planes */
+unsigned int cameraconvert_planes(uint32_t fourcc, unsigned char const * data,
+		size_t size, size_t stride, unsigned int width,
+		unsigned int height,
+		CameraConvertPlane planes[CAMERACONVERT_PLANES_MAX])
+{
+	CameraConvertSource const * source;
+	unsigned int i;
+	unsigned int cnt;
+
+	if((source = _convert_source(fourcc)) == NULL)
+		return 0;
+	if(stride == 0)
+		stride = (size_t)width * source->bpp;
+	planes[0].data = data;
+	planes[0].stride = stride;
+	planes[0].size = MIN(size, stride * height);
+	if(source->chroma == CCC_NONE)
+		return 1;
+	/* the chrominance follows, with half as many rows */
+	cnt = (source->chroma == CCC_INTERLEAVED) ? 2 : 3;
+	for(i = 1; i < cnt; i++)
+	{
+		data += planes[i - 1].size;
+		size -= planes[i - 1].size;
+		planes[i].data = data;
+		planes[i].stride = (source->chroma == CCC_INTERLEAVED)
+			? stride : stride / 2;
+		planes[i].size = MIN(size, planes[i].stride
+				* ((height + 1) / 2));
+	}
+	return cnt;
+}
+
+
+/* private */
+/* functions */
+/* convert_select */
+static void _convert_select(CameraConvert * convert)
+{
+	CameraConvertRow (*packed)[CCF_COUNT] = convert->packed;
+
+	/* the scalar kernels are the reference implementation */
+	packed[CCK_YUYV][CCF_RGB24] = _convert_yuyv_rgb24;
+	packed[CCK_YUYV][CCF_XRGB32] = _convert_yuyv_xrgb32;
+	packed[CCK_UYVY][CCF_RGB24] = _convert_uyvy_rgb24;
+	packed[CCK_UYVY][CCF_XRGB32] = _convert_uyvy_xrgb32;
+	packed[CCK_GREY][CCF_RGB24] = _convert_grey_rgb24;
+	packed[CCK_GREY][CCF_XRGB32] = _convert_grey_xrgb32;
+	packed[CCK_RGB24][CCF_RGB24] = _convert_rgb24_rgb24;
+	packed[CCK_RGB24][CCF_XRGB32] = _convert_rgb24_xrgb32;
+	packed[CCK_BGR24][CCF_RGB24] = _convert_bgr24_rgb24;
+	packed[CCK_BGR24][CCF_XRGB32] = _convert_bgr24_xrgb32;
+	convert->yuv420[CCF_RGB24] = _convert_yuv420_rgb24;
+	convert->yuv420[CCF_XRGB32] = _convert_yuv420_xrgb32;
+	convert->reverse[CCF_RGB24] = _convert_reverse_rgb24;
+	convert->reverse[CCF_XRGB32] = _convert_reverse_xrgb32;
+	convert->blend = _convert_blend;
+	convert->decimate2[CCF_RGB24] = _convert_decimate2_rgb24;
+	convert->decimate2[CCF_XRGB32] = _convert_decimate2_xrgb32;
+	convert->decimate4[CCF_RGB24] = _convert_decimate4_rgb24;
+	convert->decimate4[CCF_XRGB32] = _convert_decimate4_xrgb32;
+#if defined(CONVERT_X86)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+	{
+		convert->reverse[CCF_XRGB32] = _convert_reverse_xrgb32_sse2;
+		convert->blend = _convert_blend_sse2;
+		convert->decimate2[CCF_XRGB32] = _convert_decimate2_xrgb32_sse2;
+		convert->decimate4[CCF_XRGB32] = _convert_decimate4_xrgb32_sse2;
+	}
+	if(__builtin_cpu_supports("ssse3"))
+	{
+		convert->reverse[CCF_RGB24] = _convert_reverse_rgb24_ssse3;
+		convert->decimate2[CCF_RGB24] = _convert_decimate2_rgb24_ssse3;
+		packed[CCK_RGB24][CCF_XRGB32] = _convert_rgb24_xrgb32_ssse3;
+		packed[CCK_BGR24][CCF_RGB24] = _convert_bgr24_rgb24_ssse3;
+		packed[CCK_BGR24][CCF_XRGB32] = _convert_bgr24_xrgb32_ssse3;
+	}
+	/* the luminance and chrominance need vector coefficients */
+	if(!convert->vector)
+		return;
+	if(__builtin_cpu_supports("sse2"))
+	{
+		packed[CCK_YUYV][CCF_RGB24] = _convert_yuyv_rgb24_sse2;
+		packed[CCK_YUYV][CCF_XRGB32] = _convert_yuyv_xrgb32_sse2;
+		packed[CCK_UYVY][CCF_XRGB32] = _convert_uyvy_xrgb32_sse2;
+		convert->yuv420[CCF_XRGB32] = _convert_yuv420_xrgb32_sse2;
+	}
+	if(__builtin_cpu_supports("ssse3"))
+	{
+		packed[CCK_YUYV][CCF_RGB24] = _convert_yuyv_rgb24_ssse3;
+		packed[CCK_UYVY][CCF_RGB24] = _convert_uyvy_rgb24_ssse3;
+		convert->yuv420[CCF_RGB24] = _convert_yuv420_rgb24_ssse3;
+	}
+	if(__builtin_cpu_supports("avx2"))
+	{
+		packed[CCK_YUYV][CCF_RGB24] = _convert_yuyv_rgb24_avx2;
+		packed[CCK_YUYV][CCF_XRGB32] = _convert_yuyv_xrgb32_avx2;
+	}
+#elif defined(CONVERT_NEON)
+	convert->reverse[CCF_RGB24] = _convert_reverse_rgb24_neon;
+	convert->reverse[CCF_XRGB32] = _convert_reverse_xrgb32_neon;
+	convert->blend = _convert_blend_neon;
+	convert->decimate2[CCF_RGB24] = _convert_decimate2_rgb24_neon;
+	convert->decimate2[CCF_XRGB32] = _convert_decimate2_xrgb32_neon;
+	convert->decimate4[CCF_RGB24] = _convert_decimate4_rgb24_neon;
+	convert->decimate4[CCF_XRGB32] = _convert_decimate4_xrgb32_neon;
+	packed[CCK_BGR24][CCF_RGB24] = _convert_bgr24_rgb24_neon;
+# if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	packed[CCK_RGB24][CCF_XRGB32] = _convert_rgb24_xrgb32_neon;
+	packed[CCK_BGR24][CCF_XRGB32] = _convert_bgr24_xrgb32_neon;
+# endif
+	/* the luminance and chrominance need vector coefficients */
+	if(!convert->vector)
+		return;
+	packed[CCK_YUYV][CCF_RGB24] = _convert_yuyv_rgb24_neon;
+	packed[CCK_UYVY][CCF_RGB24] = _convert_uyvy_rgb24_neon;
+	convert->yuv420[CCF_RGB24] = _convert_yuv420_rgb24_neon;
+# if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	packed[CCK_YUYV][CCF_XRGB32] = _convert_yuyv_xrgb32_neon;
+	packed[CCK_UYVY][CCF_XRGB32] = _convert_uyvy_xrgb32_neon;
+	convert->yuv420[CCF_XRGB32] = _convert_yuv420_xrgb32_neon;
+# endif
+#endif
+}
+
+
+/* convert_tables */
+static int32_t _tables_fixed(double value);
+
+static void _convert_tables(CameraConvert * convert)
+{
+	double amp = convert->amp;
+	unsigned int i;
+
+	/* the offsets are folded into the chrominance tables */
+	for(i = 0; i < 256; i++)
+	{
+		convert->y[i] = _tables_fixed(amp * 0.004565 * i);
+		convert->ru[i] = _tables_fixed(amp * 0.000001 * i);
+		convert->rv[i] = _tables_fixed(amp * (0.006250 * i - 0.872));
+		convert->gu[i] = _tables_fixed(amp * -0.001542 * i);
+		convert->gv[i] = _tables_fixed(amp * (-0.003183 * i + 0.531));
+		convert->bu[i] = _tables_fixed(amp * (0.007935 * i - 1.088));
+	}
+}
+
+static int32_t _tables_fixed(double value)
+{
+	value *= 1 << CONVERT_SHIFT;
+	return (value < 0) ? value - 0.5 : value + 0.5;
+}
+
+
+/* convert_vector */
+static int _vector_fixed(double value, int shift, int16_t * fixed);
+
+static void _convert_vector(CameraConvert * convert)
+{
+	double amp = convert->amp;
+
+	/* the kernels multiply (x << 7) by coefficients with 13 bits of
+	 * fraction and keep the high 16 bits, leaving 4 bits of fraction;
+	 * the chrominance is centered, and the negligible contribution of
+	 * U to red is folded into its offset */
+	convert->vector = _vector_fixed(amp * 0.004565, 13, &convert->cy) == 0
+		&& _vector_fixed(amp * 0.006250, 13, &convert->crv) == 0
+		&& _vector_fixed(amp * -0.001542, 13, &convert->cgu) == 0
+		&& _vector_fixed(amp * -0.003183, 13, &convert->cgv) == 0
+		&& _vector_fixed(amp * 0.007935, 13, &convert->cbu) == 0
+		&& _vector_fixed(amp * (-0.872 + 0.000001 * 128
+					+ 0.006250 * 128), 4,
+				&convert->kr) == 0
+		&& _vector_fixed(amp * (0.531 - 0.001542 * 128
+					- 0.003183 * 128), 4,
+				&convert->kg) == 0
+		&& _vector_fixed(amp * (-1.088 + 0.007935 * 128), 4,
+				&convert->kb) == 0;
+}
+
+static int _vector_fixed(double value, int shift, int16_t * fixed)
+{
+	value *= 1 << shift;
+	value = (value < 0) ? value - 0.5 : value + 0.5;
+	if(value <= INT16_MIN || value >= INT16_MAX)
+		return -1;
+	*fixed = value;
+	return 0;
+}
+
+
+/* convert_source */
+static CameraConvertSource const * _convert_source(uint32_t fourcc)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(_convert_sources) / sizeof(*_convert_sources);
+			i++)
+		if(_convert_sources[i].fourcc == fourcc)
+			return &_convert_sources[i];
+	return NULL;
+}
+
+
+/* convert_band */
+static void _convert_band(CameraConvert * convert, CameraConvertBand * band)
+{
+	if(band->scale != NULL)
+		_convert_scale_rows(convert, band);
+	else
+		_convert_rows(convert, band);
+}
+
+
+/* convert_bands */
+static void _convert_bands(CameraConvert * convert, CameraConvertBand * frame)
+{
+	CameraConvertBand * band;
+	unsigned int bands;
+	unsigned int i;
+	unsigned int y;
+
+	bands = MIN(convert->bands, frame->height / CONVERT_BAND_ROWS);
+	if(bands <= 1)
+	{
+		_convert_band(convert, frame);
+		return;
+	}
+	/* split the frame in bands of rows */
+	for(i = 0; i < bands; i++)
+	{
+		band = &convert->band[i];
+		*band = *frame;
+		y = frame->height * i / bands;
+		band->dst = &frame->dst[frame->dst_stride * y];
+		band->height = frame->height * (i + 1) / bands - y;
+		band->y = y;
+		if(frame->scale != NULL)
+			band->scratch = &frame->scratch[convert->scratch_row
+				* CONVERT_SCRATCH_ROWS * i];
+	}
+	g_mutex_lock(&convert->mutex);
+	convert->pending = bands - 1;
+	g_mutex_unlock(&convert->mutex);
+	for(i = 1; i < bands; i++)
+		if(g_thread_pool_push(convert->pool, &convert->band[i], NULL)
+				!= TRUE)
+			_set_bands_on_band(&convert->band[i], convert);
+	_convert_band(convert, &convert->band[0]);
+	/* wait for the other bands */
+	g_mutex_lock(&convert->mutex);
+	while(convert->pending > 0)
+		g_cond_wait(&convert->cond, &convert->mutex);
+	g_mutex_unlock(&convert->mutex);
+}
+
+
+/* convert_frame */
+static int _convert_frame(CameraConvert * convert, CameraConvertBand * frame,
+		uint32_t fourcc, CameraConvertFormat format,
+		CameraConvertPlane const * planes, unsigned int width,
+		unsigned int * height)
+{
+	CameraConvertSource const * source;
+	CameraConvertPlane plane;
+	unsigned int i;
+	size_t size;
+	size_t rows;
+
+	if((source = _convert_source(fourcc)) == NULL)
+		return -error_set_code(1, "%s", _("Unsupported format"));
+	frame->row = NULL;
+	frame->planar = NULL;
+	frame->plane[0] = planes[0];
+	frame->step = 0;
+	switch(source->chroma)
+	{
+		case CCC_NONE:
+			frame->row = convert->packed[source->kernel][format];
+			break;
+		case CCC_INTERLEAVED:
+			frame->planar = convert->yuv420[format];
+			frame->plane[1] = planes[1];
+			frame->plane[2] = planes[1];
+			frame->plane[2].data = &planes[1].data[1];
+			frame->step = 2;
+			break;
+		case CCC_PLANAR:
+			frame->planar = convert->yuv420[format];
+			frame->plane[1] = planes[1];
+			frame->plane[2] = planes[2];
+			frame->step = 1;
+			break;
+	}
+	if(source->swap)
+	{
+		plane = frame->plane[1];
+		frame->plane[1] = frame->plane[2];
+		frame->plane[2] = plane;
+	}
+	/* do not read past the data captured, the last row may be short */
+	for(i = 0; i < ((source->chroma == CCC_NONE) ? 1 : 3); i++)
+	{
+		size = (i == 0) ? (size_t)width * source->bpp
+			: (size_t)(width + 1) / 2 * frame->step;
+		if(frame->plane[i].stride == 0 || frame->plane[i].size < size)
+		{
+			*height = 0;
+			continue;
+		}
+		rows = (frame->plane[i].size - size) / frame->plane[i].stride
+			+ 1;
+		*height = MIN(*height, (i == 0) ? rows : rows * 2);
+	}
+	return 0;
+}
+
+
+/* convert_row */
+static void _convert_row(CameraConvert * convert,
+		CameraConvertBand const * band, unsigned int y,
+		unsigned char * dst, unsigned int width)
+{
+	CameraConvertPlane const * plane = band->plane;
+
+	if(band->planar == NULL)
+		band->row(convert, &plane[0].data[plane[0].stride * y], dst,
+				width);
+	else
+		band->planar(convert, &plane[0].data[plane[0].stride * y],
+				&plane[1].data[plane[1].stride * (y / 2)],
+				&plane[2].data[plane[2].stride * (y / 2)],
+				band->step, dst, width);
+}
+
+
+/* convert_rows */
+static void _convert_rows(CameraConvert * convert, CameraConvertBand * band)
+{
+	unsigned int i;
+
+	for(i = 0; i < band->height; i++)
+		_convert_row(convert, band, band->y + i,
+				&band->dst[band->dst_stride * i], band->width);
+}
+
+
+/* convert_scale */
+static unsigned int _scale_area(unsigned int d, unsigned int dst,
+		unsigned int src, unsigned int taps, uint16_t * weight);
+static void _scale_position(unsigned int d, unsigned int dst, unsigned int src,
+		CameraConvertInterp interp, unsigned int * s,
+		unsigned int * weight);
+
+static int _convert_scale(CameraConvert * convert, CameraConvertFormat format,
+		CameraConvertInterp interp, CameraConvertFlip flip,
+		unsigned int src_width, unsigned int src_height,
+		unsigned int dst_width, unsigned int dst_height)
+{
+	CameraConvertScale * scale = &convert->scale;
+	size_t bpp = (format == CCF_XRGB32) ? 4 : 3;
+	size_t row;
+	size_t size;
+	unsigned char * p;
+	size_t * offset;
+	uint16_t * weight;
+	unsigned int * rows;
+	unsigned int taps = 1;
+	unsigned int row_taps = 0;
+	unsigned int x;
+	unsigned int y;
+	unsigned int s;
+	unsigned int w;
+
+	/* keep room for the neighbour of the last pixel */
+	row = (MAX(src_width, dst_width) * 4 + 4 + 63) & ~(size_t)63;
+	size = row * CONVERT_SCRATCH_ROWS * convert->bands;
+	if(size > convert->scratch_size)
+	{
+		if((p = realloc(convert->scratch, size)) == NULL)
+			return -error_set_code(-errno, "%s", strerror(errno));
+		memset(p, 0, size);
+		convert->scratch = p;
+		convert->scratch_size = size;
+	}
+	convert->scratch_row = row;
+	if(scale->format == format && scale->interp == interp
+			&& scale->flip == flip
+			&& scale->src_width == src_width
+			&& scale->src_height == src_height
+			&& scale->dst_width == dst_width
+			&& scale->dst_height == dst_height)
+		return 0;
+	/* invalidate the map until it is complete */
+	scale->src_width = 0;
+	if(interp == CCI_AREA)
+	{
+		/* as many source pixels as a destination pixel may cover */
+		taps = (src_width + dst_width - 1) / dst_width + 1;
+		row_taps = (src_height + dst_height - 1) / dst_height + 1;
+		if((rows = realloc(scale->row, sizeof(*rows) * dst_height))
+				== NULL)
+			return -error_set_code(-errno, "%s", strerror(errno));
+		scale->row = rows;
+		if((weight = realloc(scale->row_weight, sizeof(*weight)
+						* dst_height * row_taps))
+				== NULL)
+			return -error_set_code(-errno, "%s", strerror(errno));
+		scale->row_weight = weight;
+		for(y = 0; y < dst_height; y++)
+			rows[y] = _scale_area(y, dst_height, src_height,
+					row_taps, &weight[row_taps * y]);
+	}
+	if((offset = realloc(scale->offset, sizeof(*offset) * dst_width))
+			== NULL)
+		return -error_set_code(-errno, "%s", strerror(errno));
+	scale->offset = offset;
+	if((weight = realloc(scale->weight, sizeof(*weight) * dst_width
+					* taps)) == NULL)
+		return -error_set_code(-errno, "%s", strerror(errno));
+	scale->weight = weight;
+	for(x = 0; x < dst_width; x++)
+	{
+		y = (flip & CCFL_HORIZONTAL) ? dst_width - 1 - x : x;
+		if(interp == CCI_AREA)
+			s = _scale_area(y, dst_width, src_width, taps,
+					&weight[taps * x]);
+		else
+		{
+			_scale_position(y, dst_width, src_width, interp, &s,
+					&w);
+			weight[x] = w;
+		}
+		offset[x] = s * bpp;
+	}
+	/* average whole blocks of pixels directly when possible */
+	scale->decimate = 0;
+	if((flip & CCFL_HORIZONTAL) == 0 && interp != CCI_NEAREST
+			&& src_width == dst_width * 2
+			&& src_height == dst_height * 2)
+		scale->decimate = 2;
+	else if((flip & CCFL_HORIZONTAL) == 0 && interp == CCI_AREA
+			&& src_width == dst_width * 4
+			&& src_height == dst_height * 4)
+		scale->decimate = 4;
+	scale->taps = taps;
+	scale->row_taps = row_taps;
+	scale->format = format;
+	scale->interp = interp;
+	scale->flip = flip;
+	scale->src_height = src_height;
+	scale->dst_width = dst_width;
+	scale->dst_height = dst_height;
+	scale->src_width = src_width;
+	return 0;
+}
+
+static unsigned int _scale_area(unsigned int d, unsigned int dst,
+		unsigned int src, unsigned int taps, uint16_t * weight)
+{
+	unsigned int const one = 1 << CONVERT_AREA_SHIFT;
+	/* the destination pixel covers [begin, end) in 1/dst source pixels */
+	uint64_t begin = (uint64_t)d * src;
+	uint64_t end = begin + src;
+	uint64_t left;
+	uint64_t right;
+	uint64_t covered = 0;
+	unsigned int first;
+	unsigned int previous = 0;
+	unsigned int sum;
+	unsigned int k;
+
+	/* do not go past the last source pixel */
+	first = begin / dst;
+	if(first + taps > src)
+		first = (src > taps) ? src - taps : 0;
+	for(k = 0; k < taps; k++)
+	{
+		left = MAX((uint64_t)(first + k) * dst, begin);
+		right = MIN((uint64_t)(first + k + 1) * dst, end);
+		if(right > left)
+			covered += right - left;
+		/* rounded cumulatively for the weights to add up to one */
+		sum = (covered * one + src / 2) / src;
+		weight[k] = sum - previous;
+		previous = sum;
+	}
+	return first;
+}
+
+static void _scale_position(unsigned int d, unsigned int dst, unsigned int src,
+		CameraConvertInterp interp, unsigned int * s,
+		unsigned int * weight)
+{
+	uint64_t pos;
+
+	if(interp == CCI_NEAREST)
+	{
+		/* the source pixel under the center of the destination */
+		*s = ((uint64_t)d * 2 + 1) * src / ((uint64_t)dst * 2);
+		*weight = 0;
+		return;
+	}
+	/* align the centers of the pixels, with 16 bits of fraction */
+	pos = ((((uint64_t)d * 2 + 1) * src) << 16) / ((uint64_t)dst * 2);
+	pos = (pos > 0x8000) ? pos - 0x8000 : 0;
+	*s = pos >> 16;
+	*weight = (pos & 0xffff) >> (16 - CONVERT_WEIGHT_SHIFT);
+	if(*s + 1 >= src)
+	{
+		*s = src - 1;
+		*weight = 0;
+	}
+}
+
+
+/* convert_scale_rows */
+static void _scale_rows_area(CameraConvert * convert,
+		CameraConvertBand * band, unsigned int cached[2],
+		unsigned int d, unsigned char * dst);
+static void _scale_rows_columns(CameraConvertScale const * scale,
+		unsigned char const * src, unsigned char * dst, size_t bpp);
+static void _scale_rows_decimate(CameraConvert * convert,
+		CameraConvertBand * band, unsigned int d, unsigned char * dst);
+static unsigned char const * _scale_rows_scaled(CameraConvert * convert,
+		CameraConvertBand * band, unsigned int cached[2],
+		unsigned int y, unsigned int keep);
+
+static void _convert_scale_rows(CameraConvert * convert,
+		CameraConvertBand * band)
+{
+	CameraConvertScale const * scale = band->scale;
+	size_t bpp = (scale->format == CCF_XRGB32) ? 4 : 3;
+	int identity = scale->src_width == scale->dst_width
+		&& (scale->flip & CCFL_HORIZONTAL) == 0;
+	unsigned int cached[2] = { UINT_MAX, UINT_MAX };
+	unsigned char * dst = band->dst;
+	unsigned char * src;
+	unsigned char const * previous = NULL;
+	unsigned int previous_y = 0;
+	unsigned int previous_w = 0;
+	unsigned char const * top;
+	unsigned char const * bottom;
+	unsigned int i;
+	unsigned int d;
+	unsigned int y;
+	unsigned int w;
+
+	for(i = 0; i < band->height; i++, dst += band->dst_stride)
+	{
+		d = band->y + i;
+		if(scale->flip & CCFL_VERTICAL)
+			d = scale->dst_height - 1 - d;
+		if(scale->decimate != 0)
+		{
+			_scale_rows_decimate(convert, band, d, dst);
+			continue;
+		}
+		if(scale->interp == CCI_AREA)
+		{
+			_scale_rows_area(convert, band, cached, d, dst);
+			continue;
+		}
+		_scale_position(d, scale->dst_height, scale->src_height,
+				scale->interp, &y, &w);
+		if(previous != NULL && y == previous_y && w == previous_w)
+		{
+			/* same source as the previous row */
+			memcpy(dst, previous, bpp * band->width);
+			continue;
+		}
+		previous = dst;
+		previous_y = y;
+		previous_w = w;
+		if(w == 0 && identity)
+			/* convert straight into the destination */
+			_convert_row(convert, band, y, dst, band->width);
+		else if(w == 0)
+		{
+			src = &band->scratch[convert->scratch_row
+				* CONVERT_SCRATCH_SOURCE];
+			_convert_row(convert, band, y, src, scale->src_width);
+			_scale_rows_columns(scale, src, dst, bpp);
+		}
+		else
+		{
+			/* every source row is only scaled once */
+			top = _scale_rows_scaled(convert, band, cached, y,
+					y + 1);
+			bottom = _scale_rows_scaled(convert, band, cached,
+					y + 1, y);
+			convert->blend(top, bottom, w, dst,
+					bpp * band->width);
+		}
+	}
+}
+
+static void _scale_rows_area(CameraConvert * convert,
+		CameraConvertBand * band, unsigned int cached[2],
+		unsigned int d, unsigned char * dst)
+{
+	CameraConvertScale const * scale = band->scale;
+	unsigned int const one = 1 << CONVERT_AREA_SHIFT;
+	size_t size = ((scale->format == CCF_XRGB32) ? 4 : 3) * band->width;
+	uint16_t const * weight = &scale->row_weight[scale->row_taps * d];
+	uint32_t * sums = (uint32_t *)&band->scratch[convert->scratch_row
+		* CONVERT_SCRATCH_SUMS];
+	unsigned char const * src;
+	unsigned int y = scale->row[d];
+	unsigned int k;
+	size_t i;
+	int first = 1;
+
+	for(k = 0; k < scale->row_taps; k++, y++)
+	{
+		if(weight[k] == 0)
+			continue;
+		/* the last row may be shared with the next destination row */
+		src = _scale_rows_scaled(convert, band, cached, y, y - 1);
+		if(weight[k] == one)
+		{
+			memcpy(dst, src, size);
+			return;
+		}
+		if(first)
+			for(i = 0; i < size; i++)
+				sums[i] = src[i] * weight[k];
+		else
+			for(i = 0; i < size; i++)
+				sums[i] += src[i] * weight[k];
+		first = 0;
+	}
+	for(i = 0; i < size; i++)
+		dst[i] = (sums[i] + (one >> 1)) >> CONVERT_AREA_SHIFT;
+}
+
+static void _scale_rows_columns(CameraConvertScale const * scale,
+		unsigned char const * src, unsigned char * dst, size_t bpp)
+{
+	unsigned int const one = 1 << CONVERT_WEIGHT_SHIFT;
+	unsigned int const area = 1 << CONVERT_AREA_SHIFT;
+	unsigned char const * p;
+	uint16_t const * weight;
+	unsigned int x;
+	unsigned int w;
+	unsigned int k;
+	uint32_t sum;
+	size_t c;
+
+	if(scale->interp == CCI_NEAREST)
+	{
+		for(x = 0; x < scale->dst_width; x++, dst += bpp)
+			memcpy(dst, &src[scale->offset[x]], bpp);
+		return;
+	}
+	if(scale->interp == CCI_AREA)
+	{
+		for(x = 0; x < scale->dst_width; x++, dst += bpp)
+		{
+			p = &src[scale->offset[x]];
+			weight = &scale->weight[scale->taps * x];
+			for(c = 0; c < bpp; c++)
+			{
+				for(sum = 0, k = 0; k < scale->taps; k++)
+					sum += p[bpp * k + c] * weight[k];
+				dst[c] = (sum + (area >> 1))
+					>> CONVERT_AREA_SHIFT;
+			}
+		}
+		return;
+	}
+	for(x = 0; x < scale->dst_width; x++, dst += bpp)
+	{
+		p = &src[scale->offset[x]];
+		w = scale->weight[x];
+		for(c = 0; c < bpp; c++)
+			dst[c] = (p[c] * (one - w) + p[bpp + c] * w
+					+ (one >> 1)) >> CONVERT_WEIGHT_SHIFT;
+	}
+}
+
+static void _scale_rows_decimate(CameraConvert * convert,
+		CameraConvertBand * band, unsigned int d, unsigned char * dst)
+{
+	CameraConvertScale const * scale = band->scale;
+	unsigned char const * rows[4];
+	unsigned char * row;
+	unsigned int i;
+
+	for(i = 0; i < scale->decimate; i++)
+	{
+		row = &band->scratch[convert->scratch_row
+			* (CONVERT_SCRATCH_SOURCE + i)];
+		_convert_row(convert, band, d * scale->decimate + i, row,
+				scale->src_width);
+		rows[i] = row;
+	}
+	if(scale->decimate == 2)
+		convert->decimate2[scale->format](rows, dst, band->width);
+	else
+		convert->decimate4[scale->format](rows, dst, band->width);
+}
+
+static unsigned char const * _scale_rows_scaled(CameraConvert * convert,
+		CameraConvertBand * band, unsigned int cached[2],
+		unsigned int y, unsigned int keep)
+{
+	CameraConvertScale const * scale = band->scale;
+	size_t bpp = (scale->format == CCF_XRGB32) ? 4 : 3;
+	unsigned char * src;
+	unsigned char * row;
+	unsigned int i;
+
+	for(i = 0; i < 2; i++)
+		if(cached[i] == y)
+			return &band->scratch[convert->scratch_row
+				* (CONVERT_SCRATCH_SCALED + i)];
+	/* replace the row not needed anymore */
+	i = (cached[0] == keep) ? 1 : 0;
+	row = &band->scratch[convert->scratch_row
+		* (CONVERT_SCRATCH_SCALED + i)];
+	if(scale->src_width == scale->dst_width
+			&& (scale->flip & CCFL_HORIZONTAL) == 0)
+		_convert_row(convert, band, y, row, band->width);
+	else
+	{
+		src = &band->scratch[convert->scratch_row
+			* CONVERT_SCRATCH_SOURCE];
+		_convert_row(convert, band, y, src, scale->src_width);
+		_scale_rows_columns(scale, src, row, bpp);
+	}
+	cached[i] = y;
+	return row;
+}
+
+
+/* convert_clamp */
+static inline uint8_t _convert_clamp(int32_t value)
+{
+	value >>= CONVERT_SHIFT;
+	return (value < 0) ? 0 : ((value > 255) ? 255 : value);
+}
+
+
+/* convert_yuyv_rgb24 */
+static void _convert_yuyv_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	int32_t y;
+	int32_t r;
+	int32_t g;
+	int32_t b;
+
+	/* the chrominance is shared by both pixels of a pair */
+	for(x = 0; x + 1 < width; x += 2, src += 4, dst += 6)
+	{
+		r = convert->ru[src[1]] + convert->rv[src[3]];
+		g = convert->gu[src[1]] + convert->gv[src[3]];
+		b = convert->bu[src[1]];
+		y = convert->y[src[0]];
+		dst[0] = _convert_clamp(y + r);
+		dst[1] = _convert_clamp(y + g);
+		dst[2] = _convert_clamp(y + b);
+		y = convert->y[src[2]];
+		dst[3] = _convert_clamp(y + r);
+		dst[4] = _convert_clamp(y + g);
+		dst[5] = _convert_clamp(y + b);
+	}
+}
+
+
+/* convert_yuyv_xrgb32 */
+static void _convert_yuyv_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	uint32_t * p = (uint32_t *)dst;
+	unsigned int x;
+	int32_t y;
+	int32_t r;
+	int32_t g;
+	int32_t b;
+
+	/* native-endian words, as expected by cairo */
+	for(x = 0; x + 1 < width; x += 2, src += 4, p += 2)
+	{
+		r = convert->ru[src[1]] + convert->rv[src[3]];
+		g = convert->gu[src[1]] + convert->gv[src[3]];
+		b = convert->bu[src[1]];
+		y = convert->y[src[0]];
+		p[0] = 0xff000000 | (_convert_clamp(y + r) << 16)
+			| (_convert_clamp(y + g) << 8) | _convert_clamp(y + b);
+		y = convert->y[src[2]];
+		p[1] = 0xff000000 | (_convert_clamp(y + r) << 16)
+			| (_convert_clamp(y + g) << 8) | _convert_clamp(y + b);
+	}
+}
+
+
+/* convert_uyvy_rgb24 */
+static void _convert_uyvy_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	int32_t y;
+	int32_t r;
+	int32_t g;
+	int32_t b;
+
+	for(x = 0; x + 1 < width; x += 2, src += 4, dst += 6)
+	{
+		r = convert->ru[src[0]] + convert->rv[src[2]];
+		g = convert->gu[src[0]] + convert->gv[src[2]];
+		b = convert->bu[src[0]];
+		y = convert->y[src[1]];
+		dst[0] = _convert_clamp(y + r);
+		dst[1] = _convert_clamp(y + g);
+		dst[2] = _convert_clamp(y + b);
+		y = convert->y[src[3]];
+		dst[3] = _convert_clamp(y + r);
+		dst[4] = _convert_clamp(y + g);
+		dst[5] = _convert_clamp(y + b);
+	}
+}
+
+
+/* convert_uyvy_xrgb32 */
+static void _convert_uyvy_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	uint32_t * p = (uint32_t *)dst;
+	unsigned int x;
+	int32_t y;
+	int32_t r;
+	int32_t g;
+	int32_t b;
+
+	for(x = 0; x + 1 < width; x += 2, src += 4, p += 2)
+	{
+		r = convert->ru[src[0]] + convert->rv[src[2]];
+		g = convert->gu[src[0]] + convert->gv[src[2]];
+		b = convert->bu[src[0]];
+		y = convert->y[src[1]];
+		p[0] = 0xff000000 | (_convert_clamp(y + r) << 16)
+			| (_convert_clamp(y + g) << 8) | _convert_clamp(y + b);
+		y = convert->y[src[3]];
+		p[1] = 0xff000000 | (_convert_clamp(y + r) << 16)
+			| (_convert_clamp(y + g) << 8) | _convert_clamp(y + b);
+	}
+}
+
+
+/* convert_yuv420_rgb24 */
+static void _convert_yuv420_rgb24(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	int32_t y;
+	int32_t r;
+	int32_t g;
+	int32_t b;
+
+	for(x = 0; x < width; x += 2, luma += 2, u += step, v += step)
+	{
+		r = convert->ru[*u] + convert->rv[*v];
+		g = convert->gu[*u] + convert->gv[*v];
+		b = convert->bu[*u];
+		y = convert->y[luma[0]];
+		*(dst++) = _convert_clamp(y + r);
+		*(dst++) = _convert_clamp(y + g);
+		*(dst++) = _convert_clamp(y + b);
+		if(x + 1 == width)
+			break;
+		y = convert->y[luma[1]];
+		*(dst++) = _convert_clamp(y + r);
+		*(dst++) = _convert_clamp(y + g);
+		*(dst++) = _convert_clamp(y + b);
+	}
+}
+
+
+/* convert_yuv420_xrgb32 */
+static void _convert_yuv420_xrgb32(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width)
+{
+	uint32_t * p = (uint32_t *)dst;
+	unsigned int x;
+	int32_t y;
+	int32_t r;
+	int32_t g;
+	int32_t b;
+
+	for(x = 0; x < width; x += 2, luma += 2, u += step, v += step)
+	{
+		r = convert->ru[*u] + convert->rv[*v];
+		g = convert->gu[*u] + convert->gv[*v];
+		b = convert->bu[*u];
+		y = convert->y[luma[0]];
+		*(p++) = 0xff000000 | (_convert_clamp(y + r) << 16)
+			| (_convert_clamp(y + g) << 8) | _convert_clamp(y + b);
+		if(x + 1 == width)
+			break;
+		y = convert->y[luma[1]];
+		*(p++) = 0xff000000 | (_convert_clamp(y + r) << 16)
+			| (_convert_clamp(y + g) << 8) | _convert_clamp(y + b);
+	}
+}
+
+
+/* convert_grey_rgb24 */
+static void _convert_grey_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	int32_t r = convert->ru[128] + convert->rv[128];
+	int32_t g = convert->gu[128] + convert->gv[128];
+	int32_t b = convert->bu[128];
+	unsigned int x;
+	int32_t y;
+
+	for(x = 0; x < width; x++, dst += 3)
+	{
+		y = convert->y[src[x]];
+		dst[0] = _convert_clamp(y + r);
+		dst[1] = _convert_clamp(y + g);
+		dst[2] = _convert_clamp(y + b);
+	}
+}
+
+
+/* convert_grey_xrgb32 */
+static void _convert_grey_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	uint32_t * p = (uint32_t *)dst;
+	int32_t r = convert->ru[128] + convert->rv[128];
+	int32_t g = convert->gu[128] + convert->gv[128];
+	int32_t b = convert->bu[128];
+	unsigned int x;
+	int32_t y;
+
+	for(x = 0; x < width; x++)
+	{
+		y = convert->y[src[x]];
+		p[x] = 0xff000000 | (_convert_clamp(y + r) << 16)
+			| (_convert_clamp(y + g) << 8) | _convert_clamp(y + b);
+	}
+}
+
+
+/* convert_rgb24_rgb24 */
+static void _convert_rgb24_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	(void) convert;
+
+	/* nothing to convert */
+	memcpy(dst, src, width * 3);
+}
+
+
+/* convert_rgb24_xrgb32 */
+static void _convert_rgb24_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	uint32_t * p = (uint32_t *)dst;
+	unsigned int x;
+	(void) convert;
+
+	for(x = 0; x < width; x++, src += 3)
+		p[x] = 0xff000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+}
+
+
+/* convert_bgr24_rgb24 */
+static void _convert_bgr24_rgb24(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	(void) convert;
+
+	for(x = 0; x < width; x++, src += 3, dst += 3)
+	{
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = src[0];
+	}
+}
+
+
+/* convert_bgr24_xrgb32 */
+static void _convert_bgr24_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	uint32_t * p = (uint32_t *)dst;
+	unsigned int x;
+	(void) convert;
+
+	for(x = 0; x < width; x++, src += 3)
+		p[x] = 0xff000000 | (src[2] << 16) | (src[1] << 8) | src[0];
+}
+
+
+/* convert_reverse_rgb24 */
+static void _convert_reverse_rgb24(unsigned char * a, unsigned char * b,
+		unsigned int width)
+{
+	unsigned char * p;
+	unsigned int x;
+	const unsigned int n = (a == b) ? width / 2 : width;
+	unsigned char t[3];
+
+	for(x = 0; x < n; x++, a += 3)
+	{
+		p = &b[(width - x - 1) * 3];
+		memcpy(t, a, sizeof(t));
+		memcpy(a, p, sizeof(t));
+		memcpy(p, t, sizeof(t));
+	}
+}
+
+
+/* convert_reverse_xrgb32 */
+static void _convert_reverse_xrgb32(unsigned char * a, unsigned char * b,
+		unsigned int width)
+{
+	uint32_t * p = (uint32_t *)a;
+	uint32_t * q = (uint32_t *)b;
+	unsigned int x;
+	const unsigned int n = (a == b) ? width / 2 : width;
+	uint32_t t;
+
+	for(x = 0; x < n; x++)
+	{
+		t = p[x];
+		p[x] = q[width - x - 1];
+		q[width - x - 1] = t;
+	}
+}
+
+
+/* convert_blend */
+static void _convert_blend(unsigned char const * top,
+		unsigned char const * bottom, unsigned int weight,
+		unsigned char * dst, size_t size)
+{
+	unsigned int const one = 1 << CONVERT_WEIGHT_SHIFT;
+	size_t i;
+
+	for(i = 0; i < size; i++)
+		dst[i] = (top[i] * (one - weight) + bottom[i] * weight
+				+ (one >> 1)) >> CONVERT_WEIGHT_SHIFT;
+}
+
+
+/* convert_decimate2_rgb24 */
+static void _decimate_rows(unsigned char const * rows[], unsigned char * dst,
+		unsigned int x, unsigned int width, size_t bpp,
+		unsigned int factor);
+
+static void _convert_decimate2_rgb24(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	_decimate_rows(rows, dst, 0, width, 3, 2);
+}
+
+static void _decimate_rows(unsigned char const * rows[], unsigned char * dst,
+		unsigned int x, unsigned int width, size_t bpp,
+		unsigned int factor)
+{
+	unsigned int const shift = (factor == 4) ? 4 : 2;
+	unsigned char const * p;
+	unsigned int sum;
+	unsigned int i;
+	unsigned int j;
+	size_t c;
+
+	/* from the first pixel not done yet */
+	for(dst += bpp * x; x < width; x++, dst += bpp)
+		for(c = 0; c < bpp; c++)
+		{
+			for(sum = 0, i = 0; i < factor; i++)
+			{
+				p = &rows[i][bpp * factor * x + c];
+				for(j = 0; j < factor; j++)
+					sum += p[bpp * j];
+			}
+			dst[c] = (sum + (1 << (shift - 1))) >> shift;
+		}
+}
+
+
+/* convert_decimate2_xrgb32 */
+static void _convert_decimate2_xrgb32(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	_decimate_rows(rows, dst, 0, width, 4, 2);
+}
+
+
+/* convert_decimate4_rgb24 */
+static void _convert_decimate4_rgb24(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	_decimate_rows(rows, dst, 0, width, 3, 4);
+}
+
+
+/* convert_decimate4_xrgb32 */
+static void _convert_decimate4_xrgb32(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	_decimate_rows(rows, dst, 0, width, 4, 4);
+}
+
+#ifdef CONVERT_X86
+/* convert_yuyv_rgb24_sse2 */
+static inline __m128i _yuyv_sse2_pack(__m128i value0, __m128i value1)
+	__attribute__((target("sse2")));
+static inline void _yuyv_sse2_pixels(CameraConvert * convert,
+		unsigned char const * src, __m128i * r, __m128i * g,
+		__m128i * b) __attribute__((target("sse2")));
+static inline void _yuv_sse2_pixels8(CameraConvert * convert, __m128i y,
+		__m128i uv, __m128i * r, __m128i * g, __m128i * b)
+	__attribute__((target("sse2")));
+
+__attribute__((target("sse2")))
+static void _convert_yuyv_rgb24_sse2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	unsigned int i;
+	__m128i r;
+	__m128i g;
+	__m128i b;
+	uint8_t rgb[3][16];
+
+	for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 48)
+	{
+		_yuyv_sse2_pixels(convert, src, &r, &g, &b);
+		_mm_storeu_si128((__m128i *)rgb[0], r);
+		_mm_storeu_si128((__m128i *)rgb[1], g);
+		_mm_storeu_si128((__m128i *)rgb[2], b);
+		for(i = 0; i < 16; i++)
+		{
+			dst[i * 3] = rgb[0][i];
+			dst[i * 3 + 1] = rgb[1][i];
+			dst[i * 3 + 2] = rgb[2][i];
+		}
+	}
+	_convert_yuyv_rgb24(convert, src, dst, width - x);
+}
+
+static inline __m128i _yuyv_sse2_pack(__m128i value0, __m128i value1)
+{
+	return _mm_packus_epi16(_mm_srai_epi16(value0, 4),
+			_mm_srai_epi16(value1, 4));
+}
+
+static inline void _yuyv_sse2_pixels(CameraConvert * convert,
+		unsigned char const * src, __m128i * r, __m128i * g,
+		__m128i * b)
+{
+	__m128i mask = _mm_set1_epi16(0x00ff);
+	__m128i yuyv;
+	__m128i r0;
+	__m128i g0;
+	__m128i b0;
+	__m128i r1;
+	__m128i g1;
+	__m128i b1;
+
+	yuyv = _mm_loadu_si128((__m128i const *)src);
+	_yuv_sse2_pixels8(convert, _mm_and_si128(yuyv, mask),
+			_mm_srli_epi16(yuyv, 8), &r0, &g0, &b0);
+	yuyv = _mm_loadu_si128((__m128i const *)&src[16]);
+	_yuv_sse2_pixels8(convert, _mm_and_si128(yuyv, mask),
+			_mm_srli_epi16(yuyv, 8), &r1, &g1, &b1);
+	*r = _yuyv_sse2_pack(r0, r1);
+	*g = _yuyv_sse2_pack(g0, g1);
+	*b = _yuyv_sse2_pack(b0, b1);
+}
+
+static inline void _yuv_sse2_pixels8(CameraConvert * convert, __m128i y,
+		__m128i uv, __m128i * r, __m128i * g, __m128i * b)
+{
+	__m128i u;
+	__m128i v;
+
+	/* luminance and centered chrominance, shifted left by 7 bits */
+	y = _mm_slli_epi16(y, 7);
+	uv = _mm_slli_epi16(_mm_sub_epi16(uv, _mm_set1_epi16(128)), 7);
+	u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv,
+				_MM_SHUFFLE(2, 2, 0, 0)),
+			_MM_SHUFFLE(2, 2, 0, 0));
+	v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv,
+				_MM_SHUFFLE(3, 3, 1, 1)),
+			_MM_SHUFFLE(3, 3, 1, 1));
+	y = _mm_mulhi_epi16(y, _mm_set1_epi16(convert->cy));
+	*r = _mm_adds_epi16(_mm_adds_epi16(y, _mm_set1_epi16(convert->kr)),
+			_mm_mulhi_epi16(v, _mm_set1_epi16(convert->crv)));
+	*g = _mm_adds_epi16(_mm_adds_epi16(y, _mm_set1_epi16(convert->kg)),
+			_mm_adds_epi16(_mm_mulhi_epi16(u,
+					_mm_set1_epi16(convert->cgu)),
+				_mm_mulhi_epi16(v,
+					_mm_set1_epi16(convert->cgv))));
+	*b = _mm_adds_epi16(_mm_adds_epi16(y, _mm_set1_epi16(convert->kb)),
+			_mm_mulhi_epi16(u, _mm_set1_epi16(convert->cbu)));
+}
+
+
+/* convert_yuyv_xrgb32_sse2 */
+static inline void _yuyv_sse2_store(unsigned char * dst, __m128i r,
+		__m128i g, __m128i b) __attribute__((target("sse2")));
+
+__attribute__((target("sse2")))
+static void _convert_yuyv_xrgb32_sse2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	__m128i r;
+	__m128i g;
+	__m128i b;
+
+	for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 64)
+	{
+		_yuyv_sse2_pixels(convert, src, &r, &g, &b);
+		_yuyv_sse2_store(dst, r, g, b);
+	}
+	_convert_yuyv_xrgb32(convert, src, dst, width - x);
+}
+
+static inline void _yuyv_sse2_store(unsigned char * dst, __m128i r,
+		__m128i g, __m128i b)
+{
+	__m128i x = _mm_set1_epi8(-1);
+	__m128i bg;
+	__m128i rx;
+
+	/* B, G, R, X in memory is xRGB in little-endian words */
+	bg = _mm_unpacklo_epi8(b, g);
+	rx = _mm_unpacklo_epi8(r, x);
+	_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(bg, rx));
+	_mm_storeu_si128((__m128i *)&dst[16], _mm_unpackhi_epi16(bg, rx));
+	bg = _mm_unpackhi_epi8(b, g);
+	rx = _mm_unpackhi_epi8(r, x);
+	_mm_storeu_si128((__m128i *)&dst[32], _mm_unpacklo_epi16(bg, rx));
+	_mm_storeu_si128((__m128i *)&dst[48], _mm_unpackhi_epi16(bg, rx));
+}
+
+
+/* convert_yuyv_rgb24_ssse3 */
+static inline void _yuyv_ssse3_store(unsigned char * dst, __m128i r,
+		__m128i g, __m128i b) __attribute__((target("ssse3")));
+
+__attribute__((target("ssse3")))
+static void _convert_yuyv_rgb24_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	__m128i r;
+	__m128i g;
+	__m128i b;
+
+	for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 48)
+	{
+		_yuyv_sse2_pixels(convert, src, &r, &g, &b);
+		_yuyv_ssse3_store(dst, r, g, b);
+	}
+	_convert_yuyv_rgb24(convert, src, dst, width - x);
+}
+
+static inline void _yuyv_ssse3_store(unsigned char * dst, __m128i r,
+		__m128i g, __m128i b)
+{
+	/* where each component goes in the three output vectors */
+	static const int8_t shuffle[3][3][16] =
+	{
+		{
+			{ 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1,
+				-1, 5 },
+			{ -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4,
+				-1, -1 },
+			{ -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1,
+				4, -1 }
+		},
+		{
+			{ -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1,
+				10, -1 },
+			{ 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1,
+				-1, 10 },
+			{ -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9,
+				-1, -1 }
+		},
+		{
+			{ -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1,
+				15, -1, -1 },
+			{ -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1,
+				-1, 15, -1 },
+			{ 10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14,
+				-1, -1, 15 }
+		}
+	};
+	size_t i;
+	__m128i v;
+
+	for(i = 0; i < 3; i++)
+	{
+		v = _mm_or_si128(_mm_or_si128(
+					_mm_shuffle_epi8(r, _mm_loadu_si128(
+							(__m128i const *)
+							shuffle[i][0])),
+					_mm_shuffle_epi8(g, _mm_loadu_si128(
+							(__m128i const *)
+							shuffle[i][1]))),
+				_mm_shuffle_epi8(b, _mm_loadu_si128(
+						(__m128i const *)
+						shuffle[i][2])));
+		_mm_storeu_si128((__m128i *)&dst[i * 16], v);
+	}
+}
+
+
+/* convert_yuyv_rgb24_avx2 */
+static inline __m256i _yuyv_avx2_pack(__m256i value0, __m256i value1)
+	__attribute__((target("avx2")));
+static inline void _yuyv_avx2_pixels(CameraConvert * convert,
+		unsigned char const * src, __m256i * r, __m256i * g,
+		__m256i * b) __attribute__((target("avx2")));
+static inline void _yuyv_avx2_pixels16(CameraConvert * convert,
+		__m256i yuyv, __m256i * r, __m256i * g, __m256i * b)
+	__attribute__((target("avx2")));
+
+__attribute__((target("avx2")))
+static void _convert_yuyv_rgb24_avx2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	__m256i r;
+	__m256i g;
+	__m256i b;
+
+	for(x = 0; x + 32 <= width; x += 32, src += 64, dst += 96)
+	{
+		_yuyv_avx2_pixels(convert, src, &r, &g, &b);
+		_yuyv_ssse3_store(dst, _mm256_castsi256_si128(r),
+				_mm256_castsi256_si128(g),
+				_mm256_castsi256_si128(b));
+		_yuyv_ssse3_store(&dst[48], _mm256_extracti128_si256(r, 1),
+				_mm256_extracti128_si256(g, 1),
+				_mm256_extracti128_si256(b, 1));
+	}
+	_convert_yuyv_rgb24_ssse3(convert, src, dst, width - x);
+}
+
+static inline void _yuyv_avx2_pixels(CameraConvert * convert,
+		unsigned char const * src, __m256i * r, __m256i * g,
+		__m256i * b)
+{
+	__m256i r0;
+	__m256i g0;
+	__m256i b0;
+	__m256i r1;
+	__m256i g1;
+	__m256i b1;
+
+	_yuyv_avx2_pixels16(convert, _mm256_loadu_si256(
+				(__m256i const *)src), &r0, &g0, &b0);
+	_yuyv_avx2_pixels16(convert, _mm256_loadu_si256(
+				(__m256i const *)&src[32]), &r1, &g1, &b1);
+	*r = _yuyv_avx2_pack(r0, r1);
+	*g = _yuyv_avx2_pack(g0, g1);
+	*b = _yuyv_avx2_pack(b0, b1);
+}
+
+static inline __m256i _yuyv_avx2_pack(__m256i value0, __m256i value1)
+{
+	/* packing works within each 128-bit lane; restore the order */
+	return _mm256_permute4x64_epi64(_mm256_packus_epi16(
+				_mm256_srai_epi16(value0, 4),
+				_mm256_srai_epi16(value1, 4)),
+			_MM_SHUFFLE(3, 1, 2, 0));
+}
+
+static inline void _yuyv_avx2_pixels16(CameraConvert * convert,
+		__m256i yuyv, __m256i * r, __m256i * g, __m256i * b)
+{
+	__m256i y;
+	__m256i uv;
+	__m256i u;
+	__m256i v;
+
+	y = _mm256_slli_epi16(_mm256_and_si256(yuyv,
+				_mm256_set1_epi16(0x00ff)), 7);
+	uv = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_srli_epi16(yuyv, 8),
+				_mm256_set1_epi16(128)), 7);
+	u = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv,
+				_MM_SHUFFLE(2, 2, 0, 0)),
+			_MM_SHUFFLE(2, 2, 0, 0));
+	v = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv,
+				_MM_SHUFFLE(3, 3, 1, 1)),
+			_MM_SHUFFLE(3, 3, 1, 1));
+	y = _mm256_mulhi_epi16(y, _mm256_set1_epi16(convert->cy));
+	*r = _mm256_adds_epi16(_mm256_adds_epi16(y,
+				_mm256_set1_epi16(convert->kr)),
+			_mm256_mulhi_epi16(v, _mm256_set1_epi16(
+					convert->crv)));
+	*g = _mm256_adds_epi16(_mm256_adds_epi16(y,
+				_mm256_set1_epi16(convert->kg)),
+			_mm256_adds_epi16(_mm256_mulhi_epi16(u,
+					_mm256_set1_epi16(convert->cgu)),
+				_mm256_mulhi_epi16(v,
+					_mm256_set1_epi16(convert->cgv))));
+	*b = _mm256_adds_epi16(_mm256_adds_epi16(y,
+				_mm256_set1_epi16(convert->kb)),
+			_mm256_mulhi_epi16(u, _mm256_set1_epi16(
+					convert->cbu)));
+}
+
+
+/* convert_yuyv_xrgb32_avx2 */
+__attribute__((target("avx2")))
+static void _convert_yuyv_xrgb32_avx2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	__m256i r;
+	__m256i g;
+	__m256i b;
+
+	for(x = 0; x + 32 <= width; x += 32, src += 64, dst += 128)
+	{
+		_yuyv_avx2_pixels(convert, src, &r, &g, &b);
+		_yuyv_sse2_store(dst, _mm256_castsi256_si128(r),
+				_mm256_castsi256_si128(g),
+				_mm256_castsi256_si128(b));
+		_yuyv_sse2_store(&dst[64], _mm256_extracti128_si256(r, 1),
+				_mm256_extracti128_si256(g, 1),
+				_mm256_extracti128_si256(b, 1));
+	}
+	_convert_yuyv_xrgb32_sse2(convert, src, dst, width - x);
+}
+
+/* convert_uyvy_rgb24_ssse3 */
+static inline void _uyvy_sse2_pixels(CameraConvert * convert,
+		unsigned char const * src, __m128i * r, __m128i * g,
+		__m128i * b) __attribute__((target("sse2")));
+
+__attribute__((target("ssse3")))
+static void _convert_uyvy_rgb24_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	__m128i r;
+	__m128i g;
+	__m128i b;
+
+	for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 48)
+	{
+		_uyvy_sse2_pixels(convert, src, &r, &g, &b);
+		_yuyv_ssse3_store(dst, r, g, b);
+	}
+	_convert_uyvy_rgb24(convert, src, dst, width - x);
+}
+
+static inline void _uyvy_sse2_pixels(CameraConvert * convert,
+		unsigned char const * src, __m128i * r, __m128i * g,
+		__m128i * b)
+{
+	__m128i mask = _mm_set1_epi16(0x00ff);
+	__m128i uyvy;
+	__m128i r0;
+	__m128i g0;
+	__m128i b0;
+	__m128i r1;
+	__m128i g1;
+	__m128i b1;
+
+	/* the same as YUYV, with the bytes of every word swapped */
+	uyvy = _mm_loadu_si128((__m128i const *)src);
+	_yuv_sse2_pixels8(convert, _mm_srli_epi16(uyvy, 8),
+			_mm_and_si128(uyvy, mask), &r0, &g0, &b0);
+	uyvy = _mm_loadu_si128((__m128i const *)&src[16]);
+	_yuv_sse2_pixels8(convert, _mm_srli_epi16(uyvy, 8),
+			_mm_and_si128(uyvy, mask), &r1, &g1, &b1);
+	*r = _yuyv_sse2_pack(r0, r1);
+	*g = _yuyv_sse2_pack(g0, g1);
+	*b = _yuyv_sse2_pack(b0, b1);
+}
+
+
+/* convert_uyvy_xrgb32_sse2 */
+__attribute__((target("sse2")))
+static void _convert_uyvy_xrgb32_sse2(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	__m128i r;
+	__m128i g;
+	__m128i b;
+
+	for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 64)
+	{
+		_uyvy_sse2_pixels(convert, src, &r, &g, &b);
+		_yuyv_sse2_store(dst, r, g, b);
+	}
+	_convert_uyvy_xrgb32(convert, src, dst, width - x);
+}
+
+
+/* convert_yuv420_rgb24_ssse3 */
+static inline void _yuv420_sse2_pixels(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, __m128i * r,
+		__m128i * g, __m128i * b) __attribute__((target("sse2")));
+
+__attribute__((target("ssse3")))
+static void _convert_yuv420_rgb24_ssse3(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	__m128i r;
+	__m128i g;
+	__m128i b;
+
+	for(x = 0; x + 16 <= width; x += 16, luma += 16, u += step * 8,
+			v += step * 8, dst += 48)
+	{
+		_yuv420_sse2_pixels(convert, luma, u, v, step, &r, &g, &b);
+		_yuyv_ssse3_store(dst, r, g, b);
+	}
+	_convert_yuv420_rgb24(convert, luma, u, v, step, dst, width - x);
+}
+
+static inline void _yuv420_sse2_pixels(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, __m128i * r,
+		__m128i * g, __m128i * b)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i y;
+	__m128i uv;
+	__m128i r0;
+	__m128i g0;
+	__m128i b0;
+	__m128i r1;
+	__m128i g1;
+	__m128i b1;
+
+	y = _mm_loadu_si128((__m128i const *)luma);
+	/* interleave the chrominance as with YUYV */
+	if(step == 1)
+		uv = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *)u),
+				_mm_loadl_epi64((__m128i const *)v));
+	else if(u < v)
+		uv = _mm_loadu_si128((__m128i const *)u);
+	else
+	{
+		/* V before U */
+		uv = _mm_loadu_si128((__m128i const *)v);
+		uv = _mm_or_si128(_mm_slli_epi16(uv, 8),
+				_mm_srli_epi16(uv, 8));
+	}
+	_yuv_sse2_pixels8(convert, _mm_unpacklo_epi8(y, zero),
+			_mm_unpacklo_epi8(uv, zero), &r0, &g0, &b0);
+	_yuv_sse2_pixels8(convert, _mm_unpackhi_epi8(y, zero),
+			_mm_unpackhi_epi8(uv, zero), &r1, &g1, &b1);
+	*r = _yuyv_sse2_pack(r0, r1);
+	*g = _yuyv_sse2_pack(g0, g1);
+	*b = _yuyv_sse2_pack(b0, b1);
+}
+
+
+/* convert_yuv420_xrgb32_sse2 */
+__attribute__((target("sse2")))
+static void _convert_yuv420_xrgb32_sse2(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	__m128i r;
+	__m128i g;
+	__m128i b;
+
+	for(x = 0; x + 16 <= width; x += 16, luma += 16, u += step * 8,
+			v += step * 8, dst += 64)
+	{
+		_yuv420_sse2_pixels(convert, luma, u, v, step, &r, &g, &b);
+		_yuyv_sse2_store(dst, r, g, b);
+	}
+	_convert_yuv420_xrgb32(convert, luma, u, v, step, dst, width - x);
+}
+
+
+/* convert_rgb24_xrgb32_ssse3 */
+static inline void _rgb24_ssse3_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width, __m128i shuffle, CameraConvertRow tail)
+	__attribute__((target("ssse3")));
+
+__attribute__((target("ssse3")))
+static void _convert_rgb24_xrgb32_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	/* B, G, R, X in memory is xRGB in little-endian words */
+	_rgb24_ssse3_xrgb32(convert, src, dst, width, _mm_setr_epi8(2, 1, 0,
+				-1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1),
+			_convert_rgb24_xrgb32);
+}
+
+static inline void _rgb24_ssse3_xrgb32(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width, __m128i shuffle, CameraConvertRow tail)
+{
+	__m128i x = _mm_set1_epi32(0xff000000);
+	unsigned int i;
+
+	/* four pixels at a time, without reading past the row */
+	for(i = 0; i + 6 <= width; i += 4, src += 12, dst += 16)
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(
+					_mm_shuffle_epi8(_mm_loadu_si128(
+							(__m128i const *)src),
+						shuffle), x));
+	tail(convert, src, dst, width - i);
+}
+
+
+/* convert_bgr24_rgb24_ssse3 */
+__attribute__((target("ssse3")))
+static void _convert_bgr24_rgb24_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	__m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9,
+			14, 13, 12, 15);
+	unsigned int x;
+
+	/* five pixels at a time, the last byte is written again next */
+	for(x = 0; x + 6 <= width; x += 5, src += 15, dst += 15)
+		_mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(
+					_mm_loadu_si128((__m128i const *)src),
+					shuffle));
+	_convert_bgr24_rgb24(convert, src, dst, width - x);
+}
+
+
+/* convert_bgr24_xrgb32_ssse3 */
+__attribute__((target("ssse3")))
+static void _convert_bgr24_xrgb32_ssse3(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	_rgb24_ssse3_xrgb32(convert, src, dst, width, _mm_setr_epi8(0, 1, 2,
+				-1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1),
+			_convert_bgr24_xrgb32);
+}
+
+
+/* convert_reverse_rgb24_ssse3 */
+static inline void _reverse_ssse3_rgb24(__m128i v[3])
+	__attribute__((target("ssse3")));
+
+__attribute__((target("ssse3")))
+static void _convert_reverse_rgb24_ssse3(unsigned char * a, unsigned char * b,
+		unsigned int width)
+{
+	const unsigned int n = (a == b) ? width / 2 : width;
+	unsigned int x;
+	unsigned char * p;
+	__m128i u[3];
+	__m128i v[3];
+
+	/* sixteen pixels from each end at a time */
+	for(x = 0; x + 16 <= n; x += 16)
+	{
+		p = &b[(width - x - 16) * 3];
+		u[0] = _mm_loadu_si128((__m128i const *)&a[x * 3]);
+		u[1] = _mm_loadu_si128((__m128i const *)&a[x * 3 + 16]);
+		u[2] = _mm_loadu_si128((__m128i const *)&a[x * 3 + 32]);
+		v[0] = _mm_loadu_si128((__m128i const *)p);
+		v[1] = _mm_loadu_si128((__m128i const *)&p[16]);
+		v[2] = _mm_loadu_si128((__m128i const *)&p[32]);
+		_reverse_ssse3_rgb24(u);
+		_reverse_ssse3_rgb24(v);
+		_mm_storeu_si128((__m128i *)&a[x * 3], v[0]);
+		_mm_storeu_si128((__m128i *)&a[x * 3 + 16], v[1]);
+		_mm_storeu_si128((__m128i *)&a[x * 3 + 32], v[2]);
+		_mm_storeu_si128((__m128i *)p, u[0]);
+		_mm_storeu_si128((__m128i *)&p[16], u[1]);
+		_mm_storeu_si128((__m128i *)&p[32], u[2]);
+	}
+	if(a == b)
+		_convert_reverse_rgb24(&a[x * 3], &a[x * 3], width - x * 2);
+	else
+		_convert_reverse_rgb24(&a[x * 3], b, width - x);
+}
+
+static inline void _reverse_ssse3_rgb24(__m128i v[3])
+{
+	__m128i r[3];
+
+	/* every byte comes from one or two of the three vectors */
+	r[0] = _mm_or_si128(_mm_shuffle_epi8(v[2], _mm_setr_epi8(13, 14, 15,
+					10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3,
+					-1)),
+			_mm_shuffle_epi8(v[1], _mm_setr_epi8(-1, -1, -1, -1,
+					-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+					-1, 14)));
+	r[1] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v[1],
+					_mm_setr_epi8(15, -1, 11, 12, 13, 8, 9,
+						10, 5, 6, 7, 2, 3, 4, -1, 0)),
+				_mm_shuffle_epi8(v[2], _mm_setr_epi8(-1, 0,
+						-1, -1, -1, -1, -1, -1, -1, -1,
+						-1, -1, -1, -1, -1, -1))),
+			_mm_shuffle_epi8(v[0], _mm_setr_epi8(-1, -1, -1, -1,
+					-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+					15, -1)));
+	r[2] = _mm_or_si128(_mm_shuffle_epi8(v[0], _mm_setr_epi8(-1, 12, 13,
+					14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1,
+					2)),
+			_mm_shuffle_epi8(v[1], _mm_setr_epi8(1, -1, -1, -1, -1,
+					-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+					-1)));
+	v[0] = r[0];
+	v[1] = r[1];
+	v[2] = r[2];
+}
+
+
+/* convert_reverse_xrgb32_sse2 */
+__attribute__((target("sse2")))
+static void _convert_reverse_xrgb32_sse2(unsigned char * a, unsigned char * b,
+		unsigned int width)
+{
+	const unsigned int n = (a == b) ? width / 2 : width;
+	unsigned int x;
+	unsigned char * p;
+	__m128i u;
+	__m128i v;
+
+	/* four pixels from each end at a time */
+	for(x = 0; x + 4 <= n; x += 4)
+	{
+		p = &b[(width - x - 4) * 4];
+		u = _mm_loadu_si128((__m128i const *)&a[x * 4]);
+		v = _mm_loadu_si128((__m128i const *)p);
+		_mm_storeu_si128((__m128i *)&a[x * 4],
+				_mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)));
+		_mm_storeu_si128((__m128i *)p,
+				_mm_shuffle_epi32(u, _MM_SHUFFLE(0, 1, 2, 3)));
+	}
+	if(a == b)
+		_convert_reverse_xrgb32(&a[x * 4], &a[x * 4], width - x * 2);
+	else
+		_convert_reverse_xrgb32(&a[x * 4], b, width - x);
+}
+
+
+/* convert_blend_sse2 */
+__attribute__((target("sse2")))
+static void _convert_blend_sse2(unsigned char const * top,
+		unsigned char const * bottom, unsigned int weight,
+		unsigned char * dst, size_t size)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wt = _mm_set1_epi16((1 << CONVERT_WEIGHT_SHIFT) - weight);
+	const __m128i wb = _mm_set1_epi16(weight);
+	const __m128i half = _mm_set1_epi16(1 << (CONVERT_WEIGHT_SHIFT - 1));
+	__m128i t;
+	__m128i b;
+	__m128i lo;
+	__m128i hi;
+	size_t i;
+
+	/* sixteen components at a time, within 16 bits */
+	for(i = 0; i + 16 <= size; i += 16)
+	{
+		t = _mm_loadu_si128((__m128i const *)&top[i]);
+		b = _mm_loadu_si128((__m128i const *)&bottom[i]);
+		lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(t, zero),
+					wt), _mm_mullo_epi16(
+					_mm_unpacklo_epi8(b, zero), wb));
+		hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(t, zero),
+					wt), _mm_mullo_epi16(
+					_mm_unpackhi_epi8(b, zero), wb));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, half),
+				CONVERT_WEIGHT_SHIFT);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, half),
+				CONVERT_WEIGHT_SHIFT);
+		_mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(lo, hi));
+	}
+	_convert_blend(&top[i], &bottom[i], weight, &dst[i], size - i);
+}
+
+
+/* convert_decimate2_rgb24_ssse3 */
+static inline __m128i _decimate2_ssse3_rgb24(unsigned char const * rows[],
+		size_t offset) __attribute__((target("ssse3")));
+
+__attribute__((target("ssse3")))
+static void _convert_decimate2_rgb24_ssse3(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	const __m128i two = _mm_set1_epi16(2);
+	__m128i lo;
+	__m128i hi;
+	__m128i v;
+	unsigned int x;
+	uint32_t last;
+
+	/* four pixels from eight at a time, reading a little further into
+	 * the room kept after the rows */
+	for(x = 0; x + 4 <= width; x += 4)
+	{
+		lo = _mm_add_epi16(_decimate2_ssse3_rgb24(rows, x * 6), two);
+		hi = _mm_add_epi16(_decimate2_ssse3_rgb24(rows, x * 6 + 12),
+				two);
+		v = _mm_packus_epi16(_mm_srli_epi16(lo, 2),
+				_mm_srli_epi16(hi, 2));
+		v = _mm_shuffle_epi8(v, _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9,
+					10, 11, 12, 13, -1, -1, -1, -1));
+		_mm_storel_epi64((__m128i *)&dst[x * 3], v);
+		last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+		memcpy(&dst[x * 3 + 8], &last, sizeof(last));
+	}
+	_decimate_rows(rows, dst, x, width, 3, 2);
+}
+
+static inline __m128i _decimate2_ssse3_rgb24(unsigned char const * rows[],
+		size_t offset)
+{
+	/* the components of both pixels of a pair side by side */
+	const __m128i pairs = _mm_setr_epi8(0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8,
+			11, -1, -1, -1, -1);
+	const __m128i ones = _mm_set1_epi8(1);
+	__m128i a;
+	__m128i b;
+
+	a = _mm_shuffle_epi8(_mm_loadu_si128(
+				(__m128i const *)&rows[0][offset]), pairs);
+	b = _mm_shuffle_epi8(_mm_loadu_si128(
+				(__m128i const *)&rows[1][offset]), pairs);
+	return _mm_add_epi16(_mm_maddubs_epi16(a, ones),
+			_mm_maddubs_epi16(b, ones));
+}
+
+
+/* convert_decimate2_xrgb32_sse2 */
+__attribute__((target("sse2")))
+static void _convert_decimate2_xrgb32_sse2(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+	__m128i a[2];
+	__m128i b[2];
+	__m128i s[4];
+	__m128i lo;
+	__m128i hi;
+	unsigned int x;
+
+	/* four pixels from eight at a time */
+	for(x = 0; x + 4 <= width; x += 4)
+	{
+		a[0] = _mm_loadu_si128((__m128i const *)&rows[0][x * 8]);
+		a[1] = _mm_loadu_si128((__m128i const *)&rows[0][x * 8 + 16]);
+		b[0] = _mm_loadu_si128((__m128i const *)&rows[1][x * 8]);
+		b[1] = _mm_loadu_si128((__m128i const *)&rows[1][x * 8 + 16]);
+		/* two pixels per register, added to the row below */
+		s[0] = _mm_add_epi16(_mm_unpacklo_epi8(a[0], zero),
+				_mm_unpacklo_epi8(b[0], zero));
+		s[1] = _mm_add_epi16(_mm_unpackhi_epi8(a[0], zero),
+				_mm_unpackhi_epi8(b[0], zero));
+		s[2] = _mm_add_epi16(_mm_unpacklo_epi8(a[1], zero),
+				_mm_unpacklo_epi8(b[1], zero));
+		s[3] = _mm_add_epi16(_mm_unpackhi_epi8(a[1], zero),
+				_mm_unpackhi_epi8(b[1], zero));
+		/* then to the pixel beside */
+		lo = _mm_add_epi16(_mm_unpacklo_epi64(s[0], s[1]),
+				_mm_unpackhi_epi64(s[0], s[1]));
+		hi = _mm_add_epi16(_mm_unpacklo_epi64(s[2], s[3]),
+				_mm_unpackhi_epi64(s[2], s[3]));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+		_mm_storeu_si128((__m128i *)&dst[x * 4],
+				_mm_packus_epi16(lo, hi));
+	}
+	_decimate_rows(rows, dst, x, width, 4, 2);
+}
+
+
+/* convert_decimate4_xrgb32_sse2 */
+static inline __m128i _decimate4_sse2_xrgb32(unsigned char const * rows[],
+		size_t offset) __attribute__((target("sse2")));
+
+__attribute__((target("sse2")))
+static void _convert_decimate4_xrgb32_sse2(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	const __m128i eight = _mm_set1_epi16(8);
+	__m128i a;
+	__m128i b;
+	__m128i v;
+	unsigned int x;
+
+	/* two pixels from blocks of 4x4 at a time */
+	for(x = 0; x + 2 <= width; x += 2)
+	{
+		a = _decimate4_sse2_xrgb32(rows, x * 16);
+		b = _decimate4_sse2_xrgb32(rows, x * 16 + 16);
+		v = _mm_add_epi16(_mm_unpacklo_epi64(a, b),
+				_mm_unpackhi_epi64(a, b));
+		v = _mm_srli_epi16(_mm_add_epi16(v, eight), 4);
+		_mm_storel_epi64((__m128i *)&dst[x * 4],
+				_mm_packus_epi16(v, v));
+	}
+	_decimate_rows(rows, dst, x, width, 4, 4);
+}
+
+static inline __m128i _decimate4_sse2_xrgb32(unsigned char const * rows[],
+		size_t offset)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum = zero;
+	__m128i v;
+	unsigned int i;
+
+	/* four pixels in each row, added two by two */
+	for(i = 0; i < 4; i++)
+	{
+		v = _mm_loadu_si128((__m128i const *)&rows[i][offset]);
+		sum = _mm_add_epi16(sum, _mm_add_epi16(
+					_mm_unpacklo_epi8(v, zero),
+					_mm_unpackhi_epi8(v, zero)));
+	}
+	return sum;
+}
+#endif
+
+
+#ifdef CONVERT_NEON
+/* convert_yuyv_rgb24_neon */
+static inline uint8x16_t _yuyv_neon_pack(int16x8_t even, int16x8_t odd);
+static inline void _yuv_neon_pixels(CameraConvert * convert,
+		uint8x8x4_t yuyv, uint8x16_t * r, uint8x16_t * g,
+		uint8x16_t * b);
+
+static void _convert_yuyv_rgb24_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	uint8x16x3_t rgb;
+
+	for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 48)
+	{
+		_yuv_neon_pixels(convert, vld4_u8(src), &rgb.val[0],
+				&rgb.val[1], &rgb.val[2]);
+		vst3q_u8(dst, rgb);
+	}
+	_convert_yuyv_rgb24(convert, src, dst, width - x);
+}
+
+static inline uint8x16_t _yuyv_neon_pack(int16x8_t even, int16x8_t odd)
+{
+	uint8x8x2_t zip;
+
+	zip = vzip_u8(vqshrun_n_s16(even, 4), vqshrun_n_s16(odd, 4));
+	return vcombine_u8(zip.val[0], zip.val[1]);
+}
+
+static inline void _yuv_neon_pixels(CameraConvert * convert,
+		uint8x8x4_t yuyv, uint8x16_t * r, uint8x16_t * g,
+		uint8x16_t * b)
+{
+	int16x8_t y0;
+	int16x8_t y1;
+	int16x8_t u;
+	int16x8_t v;
+	int16x8_t c;
+
+	/* even luminance, U, odd luminance and V */
+	/* vqdmulhq_s16() doubles the product: shift by 6 only */
+	y0 = vreinterpretq_s16_u16(vshll_n_u8(yuyv.val[0], 6));
+	y1 = vreinterpretq_s16_u16(vshll_n_u8(yuyv.val[2], 6));
+	u = vshlq_n_s16(vreinterpretq_s16_u16(vsubl_u8(yuyv.val[1],
+					vdup_n_u8(128))), 6);
+	v = vshlq_n_s16(vreinterpretq_s16_u16(vsubl_u8(yuyv.val[3],
+					vdup_n_u8(128))), 6);
+	y0 = vqdmulhq_n_s16(y0, convert->cy);
+	y1 = vqdmulhq_n_s16(y1, convert->cy);
+	c = vqaddq_s16(vqdmulhq_n_s16(v, convert->crv),
+			vdupq_n_s16(convert->kr));
+	*r = _yuyv_neon_pack(vqaddq_s16(y0, c), vqaddq_s16(y1, c));
+	c = vqaddq_s16(vqaddq_s16(vqdmulhq_n_s16(u, convert->cgu),
+				vqdmulhq_n_s16(v, convert->cgv)),
+			vdupq_n_s16(convert->kg));
+	*g = _yuyv_neon_pack(vqaddq_s16(y0, c), vqaddq_s16(y1, c));
+	c = vqaddq_s16(vqdmulhq_n_s16(u, convert->cbu),
+			vdupq_n_s16(convert->kb));
+	*b = _yuyv_neon_pack(vqaddq_s16(y0, c), vqaddq_s16(y1, c));
+}
+
+
+# if G_BYTE_ORDER == G_LITTLE_ENDIAN
+/* convert_yuyv_xrgb32_neon */
+static void _convert_yuyv_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	uint8x16x4_t bgrx;
+
+	/* B, G, R, X in memory is xRGB in little-endian words */
+	bgrx.val[3] = vdupq_n_u8(0xff);
+	for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 64)
+	{
+		_yuv_neon_pixels(convert, vld4_u8(src), &bgrx.val[2],
+				&bgrx.val[1], &bgrx.val[0]);
+		vst4q_u8(dst, bgrx);
+	}
+	_convert_yuyv_xrgb32(convert, src, dst, width - x);
+}
+# endif
+
+
+/* convert_uyvy_rgb24_neon */
+static inline uint8x8x4_t _uyvy_neon_load(unsigned char const * src);
+
+static void _convert_uyvy_rgb24_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	uint8x16x3_t rgb;
+
+	for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 48)
+	{
+		_yuv_neon_pixels(convert, _uyvy_neon_load(src), &rgb.val[0],
+				&rgb.val[1], &rgb.val[2]);
+		vst3q_u8(dst, rgb);
+	}
+	_convert_uyvy_rgb24(convert, src, dst, width - x);
+}
+
+static inline uint8x8x4_t _uyvy_neon_load(unsigned char const * src)
+{
+	uint8x8x4_t uyvy;
+	uint8x8x4_t yuyv;
+
+	uyvy = vld4_u8(src);
+	yuyv.val[0] = uyvy.val[1];
+	yuyv.val[1] = uyvy.val[0];
+	yuyv.val[2] = uyvy.val[3];
+	yuyv.val[3] = uyvy.val[2];
+	return yuyv;
+}
+
+
+/* convert_yuv420_rgb24_neon */
+static inline uint8x8x4_t _yuv420_neon_load(unsigned char const * luma,
+		unsigned char const * u, unsigned char const * v, size_t step);
+
+static void _convert_yuv420_rgb24_neon(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	uint8x16x3_t rgb;
+
+	for(x = 0; x + 16 <= width; x += 16, luma += 16, u += step * 8,
+			v += step * 8, dst += 48)
+	{
+		_yuv_neon_pixels(convert, _yuv420_neon_load(luma, u, v, step),
+				&rgb.val[0], &rgb.val[1], &rgb.val[2]);
+		vst3q_u8(dst, rgb);
+	}
+	_convert_yuv420_rgb24(convert, luma, u, v, step, dst, width - x);
+}
+
+static inline uint8x8x4_t _yuv420_neon_load(unsigned char const * luma,
+		unsigned char const * u, unsigned char const * v, size_t step)
+{
+	uint8x8x2_t y;
+	uint8x8x2_t uv;
+	uint8x8x4_t yuyv;
+
+	y = vld2_u8(luma);
+	yuyv.val[0] = y.val[0];
+	yuyv.val[2] = y.val[1];
+	if(step == 1)
+	{
+		yuyv.val[1] = vld1_u8(u);
+		yuyv.val[3] = vld1_u8(v);
+	}
+	else if(u < v)
+	{
+		uv = vld2_u8(u);
+		yuyv.val[1] = uv.val[0];
+		yuyv.val[3] = uv.val[1];
+	}
+	else
+	{
+		/* V before U */
+		uv = vld2_u8(v);
+		yuyv.val[1] = uv.val[1];
+		yuyv.val[3] = uv.val[0];
+	}
+	return yuyv;
+}
+
+
+/* convert_bgr24_rgb24_neon */
+static void _convert_bgr24_rgb24_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	uint8x16x3_t rgb;
+	uint8x16_t t;
+
+	for(x = 0; x + 16 <= width; x += 16, src += 48, dst += 48)
+	{
+		rgb = vld3q_u8(src);
+		t = rgb.val[0];
+		rgb.val[0] = rgb.val[2];
+		rgb.val[2] = t;
+		vst3q_u8(dst, rgb);
+	}
+	_convert_bgr24_rgb24(convert, src, dst, width - x);
+}
+
+
+# if G_BYTE_ORDER == G_LITTLE_ENDIAN
+/* convert_uyvy_xrgb32_neon */
+static void _convert_uyvy_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	uint8x16x4_t bgrx;
+
+	bgrx.val[3] = vdupq_n_u8(0xff);
+	for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 64)
+	{
+		_yuv_neon_pixels(convert, _uyvy_neon_load(src), &bgrx.val[2],
+				&bgrx.val[1], &bgrx.val[0]);
+		vst4q_u8(dst, bgrx);
+	}
+	_convert_uyvy_xrgb32(convert, src, dst, width - x);
+}
+
+
+/* convert_yuv420_xrgb32_neon */
+static void _convert_yuv420_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * luma, unsigned char const * u,
+		unsigned char const * v, size_t step, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	uint8x16x4_t bgrx;
+
+	bgrx.val[3] = vdupq_n_u8(0xff);
+	for(x = 0; x + 16 <= width; x += 16, luma += 16, u += step * 8,
+			v += step * 8, dst += 64)
+	{
+		_yuv_neon_pixels(convert, _yuv420_neon_load(luma, u, v, step),
+				&bgrx.val[2], &bgrx.val[1], &bgrx.val[0]);
+		vst4q_u8(dst, bgrx);
+	}
+	_convert_yuv420_xrgb32(convert, luma, u, v, step, dst, width - x);
+}
+
+
+/* convert_rgb24_xrgb32_neon */
+static void _convert_rgb24_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	uint8x16x3_t rgb;
+	uint8x16x4_t bgrx;
+
+	bgrx.val[3] = vdupq_n_u8(0xff);
+	for(x = 0; x + 16 <= width; x += 16, src += 48, dst += 64)
+	{
+		rgb = vld3q_u8(src);
+		bgrx.val[0] = rgb.val[2];
+		bgrx.val[1] = rgb.val[1];
+		bgrx.val[2] = rgb.val[0];
+		vst4q_u8(dst, bgrx);
+	}
+	_convert_rgb24_xrgb32(convert, src, dst, width - x);
+}
+
+
+/* convert_bgr24_xrgb32_neon */
+static void _convert_bgr24_xrgb32_neon(CameraConvert * convert,
+		unsigned char const * src, unsigned char * dst,
+		unsigned int width)
+{
+	unsigned int x;
+	uint8x16x3_t bgr;
+	uint8x16x4_t bgrx;
+
+	bgrx.val[3] = vdupq_n_u8(0xff);
+	for(x = 0; x + 16 <= width; x += 16, src += 48, dst += 64)
+	{
+		bgr = vld3q_u8(src);
+		bgrx.val[0] = bgr.val[0];
+		bgrx.val[1] = bgr.val[1];
+		bgrx.val[2] = bgr.val[2];
+		vst4q_u8(dst, bgrx);
+	}
+	_convert_bgr24_xrgb32(convert, src, dst, width - x);
+}
+# endif
+
+
+/* convert_reverse_rgb24_neon */
+static inline uint8x16_t _reverse_neon(uint8x16_t v);
+
+static void _convert_reverse_rgb24_neon(unsigned char * a, unsigned char * b,
+		unsigned int width)
+{
+	const unsigned int n = (a == b) ? width / 2 : width;
+	unsigned int x;
+	unsigned char * p;
+	uint8x16x3_t u;
+	uint8x16x3_t v;
+	uint8x16x3_t r;
+	int i;
+
+	/* sixteen pixels from each end at a time, by channel */
+	for(x = 0; x + 16 <= n; x += 16)
+	{
+		p = &b[(width - x - 16) * 3];
+		u = vld3q_u8(&a[x * 3]);
+		v = vld3q_u8(p);
+		for(i = 0; i < 3; i++)
+			r.val[i] = _reverse_neon(v.val[i]);
+		vst3q_u8(&a[x * 3], r);
+		for(i = 0; i < 3; i++)
+			r.val[i] = _reverse_neon(u.val[i]);
+		vst3q_u8(p, r);
+	}
+	if(a == b)
+		_convert_reverse_rgb24(&a[x * 3], &a[x * 3], width - x * 2);
+	else
+		_convert_reverse_rgb24(&a[x * 3], b, width - x);
+}
+
+static inline uint8x16_t _reverse_neon(uint8x16_t v)
+{
+	v = vrev64q_u8(v);
+	return vcombine_u8(vget_high_u8(v), vget_low_u8(v));
+}
+
+
+/* convert_reverse_xrgb32_neon */
+static void _convert_reverse_xrgb32_neon(unsigned char * a, unsigned char * b,
+		unsigned int width)
+{
+	const unsigned int n = (a == b) ? width / 2 : width;
+	unsigned int x;
+	unsigned char * p;
+	uint32x4_t u;
+	uint32x4_t v;
+
+	/* four pixels from each end at a time */
+	for(x = 0; x + 4 <= n; x += 4)
+	{
+		p = &b[(width - x - 4) * 4];
+		u = vrev64q_u32(vld1q_u32((uint32_t const *)&a[x * 4]));
+		v = vrev64q_u32(vld1q_u32((uint32_t const *)p));
+		vst1q_u32((uint32_t *)&a[x * 4], vcombine_u32(vget_high_u32(v),
+					vget_low_u32(v)));
+		vst1q_u32((uint32_t *)p, vcombine_u32(vget_high_u32(u),
+					vget_low_u32(u)));
+	}
+	if(a == b)
+		_convert_reverse_xrgb32(&a[x * 4], &a[x * 4], width - x * 2);
+	else
+		_convert_reverse_xrgb32(&a[x * 4], b, width - x);
+}
+
+
+/* convert_blend_neon */
+static void _convert_blend_neon(unsigned char const * top,
+		unsigned char const * bottom, unsigned int weight,
+		unsigned char * dst, size_t size)
+{
+	const uint8x8_t wt = vdup_n_u8((1 << CONVERT_WEIGHT_SHIFT) - weight);
+	const uint8x8_t wb = vdup_n_u8(weight);
+	uint8x16_t t;
+	uint8x16_t b;
+	uint16x8_t lo;
+	uint16x8_t hi;
+	size_t i;
+
+	/* the weights only fit in a byte when both rows are blended */
+	if(weight == 0)
+	{
+		memcpy(dst, top, size);
+		return;
+	}
+	for(i = 0; i + 16 <= size; i += 16)
+	{
+		t = vld1q_u8(&top[i]);
+		b = vld1q_u8(&bottom[i]);
+		lo = vmlal_u8(vmull_u8(vget_low_u8(t), wt), vget_low_u8(b), wb);
+		hi = vmlal_u8(vmull_u8(vget_high_u8(t), wt), vget_high_u8(b),
+				wb);
+		vst1q_u8(&dst[i], vcombine_u8(vrshrn_n_u16(lo,
+						CONVERT_WEIGHT_SHIFT),
+					vrshrn_n_u16(hi,
+						CONVERT_WEIGHT_SHIFT)));
+	}
+	_convert_blend(&top[i], &bottom[i], weight, &dst[i], size - i);
+}
+
+
+/* convert_decimate2_rgb24_neon */
+static void _convert_decimate2_rgb24_neon(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	uint8x16x3_t a;
+	uint8x16x3_t b;
+	uint8x8x3_t v;
+	unsigned int x;
+	int c;
+
+	/* eight pixels from sixteen at a time, by component */
+	for(x = 0; x + 8 <= width; x += 8)
+	{
+		a = vld3q_u8(&rows[0][x * 6]);
+		b = vld3q_u8(&rows[1][x * 6]);
+		for(c = 0; c < 3; c++)
+			v.val[c] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(
+							a.val[c]), b.val[c]),
+					2);
+		vst3_u8(&dst[x * 3], v);
+	}
+	_decimate_rows(rows, dst, x, width, 3, 2);
+}
+
+
+/* convert_decimate2_xrgb32_neon */
+static void _convert_decimate2_xrgb32_neon(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	uint8x16x4_t a;
+	uint8x16x4_t b;
+	uint8x8x4_t v;
+	unsigned int x;
+	int c;
+
+	/* eight pixels from sixteen at a time, by component */
+	for(x = 0; x + 8 <= width; x += 8)
+	{
+		a = vld4q_u8(&rows[0][x * 8]);
+		b = vld4q_u8(&rows[1][x * 8]);
+		for(c = 0; c < 4; c++)
+			v.val[c] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(
+							a.val[c]), b.val[c]),
+					2);
+		vst4_u8(&dst[x * 4], v);
+	}
+	_decimate_rows(rows, dst, x, width, 4, 2);
+}
+
+
+/* convert_decimate4_rgb24_neon */
+static inline uint8x8_t _decimate4_neon(uint16x8_t a, uint16x8_t b);
+
+static void _convert_decimate4_rgb24_neon(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	uint8x16x3_t a;
+	uint8x16x3_t b;
+	uint16x8_t s[3];
+	uint16x8_t t[3];
+	uint8x8x3_t v;
+	unsigned int x;
+	unsigned int i;
+	int c;
+
+	/* eight pixels from 32 at a time, by component */
+	for(x = 0; x + 8 <= width; x += 8)
+	{
+		for(c = 0; c < 3; c++)
+			s[c] = t[c] = vdupq_n_u16(0);
+		for(i = 0; i < 4; i++)
+		{
+			a = vld3q_u8(&rows[i][x * 12]);
+			b = vld3q_u8(&rows[i][x * 12 + 48]);
+			for(c = 0; c < 3; c++)
+			{
+				s[c] = vpadalq_u8(s[c], a.val[c]);
+				t[c] = vpadalq_u8(t[c], b.val[c]);
+			}
+		}
+		for(c = 0; c < 3; c++)
+			v.val[c] = _decimate4_neon(s[c], t[c]);
+		vst3_u8(&dst[x * 3], v);
+	}
+	_decimate_rows(rows, dst, x, width, 3, 4);
+}
+
+static inline uint8x8_t _decimate4_neon(uint16x8_t a, uint16x8_t b)
+{
+	/* the sums of pairs of columns, added pairwise again */
+	return vrshrn_n_u16(vcombine_u16(
+				vpadd_u16(vget_low_u16(a), vget_high_u16(a)),
+				vpadd_u16(vget_low_u16(b), vget_high_u16(b))),
+			4);
+}
+
+
+/* convert_decimate4_xrgb32_neon */
+static void _convert_decimate4_xrgb32_neon(unsigned char const * rows[],
+		unsigned char * dst, unsigned int width)
+{
+	uint8x16x4_t a;
+	uint8x16x4_t b;
+	uint16x8_t s[4];
+	uint16x8_t t[4];
+	uint8x8x4_t v;
+	unsigned int x;
+	unsigned int i;
+	int c;
+
+	/* eight pixels from 32 at a time, by component */
+	for(x = 0; x + 8 <= width; x += 8)
+	{
+		for(c = 0; c < 4; c++)
+			s[c] = t[c] = vdupq_n_u16(0);
+		for(i = 0; i < 4; i++)
+		{
+			a = vld4q_u8(&rows[i][x * 16]);
+			b = vld4q_u8(&rows[i][x * 16 + 64]);
+			for(c = 0; c < 4; c++)
+			{
+				s[c] = vpadalq_u8(s[c], a.val[c]);
+				t[c] = vpadalq_u8(t[c], b.val[c]);
+			}
+		}
+		for(c = 0; c < 4; c++)
+			v.val[c] = _decimate4_neon(s[c], t[c]);
+		vst4_u8(&dst[x * 4], v);
+	}
+	_decimate_rows(rows, dst, x, width, 4, 4);
+}
+#endif
@@ -0,0 +1,114 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Camera */
+/* Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ITS AUTHORS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+#ifndef CAMERA_CONVERT_H
+# define CAMERA_CONVERT_H
+
+# include <stddef.h>
+# include <stdint.h>
+
+
+/* CameraConvert */
+/* public */
+/* types */
+typedef struct _CameraConvert CameraConvert;
+
+/* same as v4l2_fourcc() */
+# define CAMERACONVERT_FOURCC(a, b, c, d) ((uint32_t)(a) \
+		| ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) \
+		| ((uint32_t)(d) << 24))
+
+typedef struct _CameraConvertPlane
+{
+	unsigned char const * data;
+	size_t stride;
+	size_t size;
+} CameraConvertPlane;
+# define CAMERACONVERT_PLANES_MAX	3
+
+typedef enum _CameraConvertFormat
+{
+	CCF_RGB24 = 0,
+	CCF_XRGB32
+} CameraConvertFormat;
+# define CCF_LAST CCF_XRGB32
+# define CCF_COUNT (CCF_LAST + 1)
+
+typedef enum _CameraConvertFlip
+{
+	CCFL_NONE = 0x0,
+	CCFL_HORIZONTAL = 0x1,
+	CCFL_VERTICAL = 0x2
+} CameraConvertFlip;
+
+typedef enum _CameraConvertInterp
+{
+	CCI_NEAREST = 0,
+	CCI_BILINEAR,
+	/* averages every source pixel covered */
+	CCI_AREA
+} CameraConvertInterp;
+# define CCI_LAST CCI_AREA
+# define CCI_COUNT (CCI_LAST + 1)
+
+
+/* functions */
+CameraConvert * cameraconvert_new(int amp);
+void cameraconvert_delete(CameraConvert * convert);
+
+/* accessors */
+int cameraconvert_get_amp(CameraConvert * convert);
+void cameraconvert_set_amp(CameraConvert * convert, int amp);
+
+unsigned int cameraconvert_get_bands(CameraConvert * convert);
+int cameraconvert_set_bands(CameraConvert * convert, unsigned int bands);
+
+/* useful */
+/* relative cost of converting from a fourcc, 0 if not supported */
+unsigned int cameraconvert_cost(uint32_t fourcc);
+/* flip frames of RGB24 or XRGB32 pixels in place */
+void cameraconvert_flip(CameraConvert * convert, CameraConvertFormat format,
+		CameraConvertFlip flip, unsigned char * data, size_t stride,
+		unsigned int width, unsigned int height);
+/* locate the planes of a frame stored in a single buffer */
+unsigned int cameraconvert_planes(uint32_t fourcc, unsigned char const * data,
+		size_t size, size_t stride, unsigned int width,
+		unsigned int height,
+		CameraConvertPlane planes[CAMERACONVERT_PLANES_MAX]);
+
+int cameraconvert_frame(CameraConvert * convert, uint32_t fourcc,
+		CameraConvertFormat format, CameraConvertPlane const * planes,
+		unsigned int width, unsigned int height,
+		unsigned char * dst, size_t dst_stride);
+int cameraconvert_frame_scale(CameraConvert * convert, uint32_t fourcc,
+		CameraConvertFormat format, CameraConvertInterp interp,
+		CameraConvertFlip flip, CameraConvertPlane const * planes,
+		unsigned int src_width, unsigned int src_height,
+		unsigned char * dst, size_t dst_stride,
+		unsigned int dst_width, unsigned int dst_height);
+
+#endif /* !CAMERA_CONVERT_H */
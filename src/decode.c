@@ -0,0 +1,258 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Camera */
+/* Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ITS AUTHORS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <libintl.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include <glib.h>
+#include <System.h>
+#include "convert.h"
+#include "decode.h"
+#define _(string) gettext(string)
+
+
+/* CameraDecode */
+/* private */
+/* types */
+typedef struct _CameraDecodeError
+{
+	struct jpeg_error_mgr error;
+	jmp_buf jmp;
+} CameraDecodeError;
+
+struct _CameraDecode
+{
+	struct jpeg_decompress_struct jpeg;
+	CameraDecodeError error;
+
+	/* rows not decoded in place */
+	unsigned char * row;
+	size_t row_size;
+};
+
+
+/* constants */
+/* the largest factor supported by the IDCT */
+#define DECODE_SHRINK_MAX	8
+
+
+/* prototypes */
+static int _decode_create(CameraDecode * decode);
+static void _decode_row(unsigned char const * src, size_t src_bpp,
+		unsigned char * dst, size_t dst_bpp, unsigned int width);
+
+/* callbacks */
+static void _decode_on_error(j_common_ptr jpeg);
+static void _decode_on_message(j_common_ptr jpeg, int level);
+
+
+/* public */
+/* functions */
+/* cameradecode_new */
+CameraDecode * cameradecode_new(void)
+{
+	CameraDecode * decode;
+
+	if((decode = object_new(sizeof(*decode))) == NULL)
+		return NULL;
+	decode->jpeg.err = jpeg_std_error(&decode->error.error);
+	decode->error.error.error_exit = _decode_on_error;
+	decode->error.error.emit_message = _decode_on_message;
+	decode->row = NULL;
+	decode->row_size = 0;
+	if(_decode_create(decode) != 0)
+	{
+		object_delete(decode);
+		return NULL;
+	}
+	return decode;
+}
+
+
+/* cameradecode_delete */
+void cameradecode_delete(CameraDecode * decode)
+{
+	jpeg_destroy_decompress(&decode->jpeg);
+	free(decode->row);
+	object_delete(decode);
+}
+
+
+/* useful */
+/* cameradecode_mjpeg_shrink */
+unsigned int cameradecode_mjpeg_shrink(unsigned int src_width,
+		unsigned int src_height, unsigned int dst_width,
+		unsigned int dst_height)
+{
+	unsigned int shrink;
+
+	/* the largest factor still not smaller than the destination */
+	for(shrink = DECODE_SHRINK_MAX; shrink > 1; shrink /= 2)
+		if((src_width + shrink - 1) / shrink >= dst_width
+				&& (src_height + shrink - 1) / shrink
+				>= dst_height)
+			break;
+	return shrink;
+}
+
+
+/* cameradecode_mjpeg */
+int cameradecode_mjpeg(CameraDecode * decode, CameraConvertFormat format,
+		unsigned int shrink, unsigned char const * src, size_t src_size,
+		unsigned char * dst, size_t dst_stride,
+		unsigned int width, unsigned int height)
+{
+	struct jpeg_decompress_struct * jpeg = &decode->jpeg;
+	size_t bpp = (format == CCF_XRGB32) ? 4 : 3;
+	gboolean direct;
+	unsigned char * p;
+	JSAMPROW row;
+	size_t cnt;
+
+	if(src_size == 0)
+		return -error_set_code(1, "%s", _("Empty frame"));
+	if(setjmp(decode->error.jmp) != 0)
+	{
+		jpeg_abort_decompress(jpeg);
+		return -1;
+	}
+	/* XXX the prototype is not const with every version of libjpeg */
+	jpeg_mem_src(jpeg, (unsigned char *)src, src_size);
+	/* the Huffman tables are often missing, libjpeg-turbo knows them */
+	jpeg_read_header(jpeg, TRUE);
+	/* scale down in the DCT domain */
+	jpeg->scale_num = 1;
+	jpeg->scale_denom = (shrink >= 1 && shrink <= DECODE_SHRINK_MAX)
+		? shrink : 1;
+	jpeg->out_color_space = JCS_RGB;
+#ifdef JCS_EXTENSIONS
+	if(format == CCF_XRGB32)
+# if G_BYTE_ORDER == G_LITTLE_ENDIAN
+		jpeg->out_color_space = JCS_EXT_BGRX;
+# else
+		jpeg->out_color_space = JCS_EXT_XRGB;
+# endif
+#endif
+	jpeg_start_decompress(jpeg);
+	direct = ((size_t)jpeg->output_components == bpp
+			&& jpeg->output_width <= width) ? TRUE : FALSE;
+	if(direct == FALSE && decode->row_size < (size_t)jpeg->output_width
+			* jpeg->output_components)
+	{
+		if((p = realloc(decode->row, jpeg->output_width
+						* jpeg->output_components))
+				== NULL)
+		{
+			jpeg_abort_decompress(jpeg);
+			return -error_set_code(1, "%s", strerror(errno));
+		}
+		decode->row = p;
+		decode->row_size = jpeg->output_width
+			* jpeg->output_components;
+	}
+	while(jpeg->output_scanline < jpeg->output_height
+			&& jpeg->output_scanline < height)
+	{
+		p = &dst[dst_stride * jpeg->output_scanline];
+		row = direct ? p : decode->row;
+		jpeg_read_scanlines(jpeg, &row, 1);
+		if(direct == FALSE)
+			_decode_row(decode->row, jpeg->output_components, p,
+					bpp, MIN(jpeg->output_width, width));
+		/* clear what the frame does not cover */
+		if(jpeg->output_width < width)
+			memset(&p[jpeg->output_width * bpp], 0,
+					(width - jpeg->output_width) * bpp);
+	}
+	for(cnt = jpeg->output_scanline; cnt < height; cnt++)
+		memset(&dst[dst_stride * cnt], 0, width * bpp);
+	if(jpeg->output_scanline < jpeg->output_height)
+		/* the frame is larger than expected */
+		jpeg_abort_decompress(jpeg);
+	else
+		jpeg_finish_decompress(jpeg);
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* decode_create */
+static int _decode_create(CameraDecode * decode)
+{
+	/* decode is not modified past setjmp() */
+	if(setjmp(decode->error.jmp) != 0)
+		return -1;
+	jpeg_create_decompress(&decode->jpeg);
+	return 0;
+}
+
+
+/* decode_row */
+static void _decode_row(unsigned char const * src, size_t src_bpp,
+		unsigned char * dst, size_t dst_bpp, unsigned int width)
+{
+	uint32_t * d = (uint32_t *)dst;
+	unsigned int i;
+
+	if(src_bpp == dst_bpp)
+		memcpy(dst, src, width * dst_bpp);
+	else
+		/* RGB24 to xRGB32 */
+		for(i = 0; i < width; i++, src += src_bpp)
+			d[i] = (src[0] << 16) | (src[1] << 8) | src[2];
+}
+
+
+/* callbacks */
+/* decode_on_error */
+static void _decode_on_error(j_common_ptr jpeg)
+{
+	CameraDecodeError * error = (CameraDecodeError *)jpeg->err;
+	char buf[JMSG_LENGTH_MAX];
+
+	error->error.format_message(jpeg, buf);
+	error_set_code(1, "%s", buf);
+	longjmp(error->jmp, 1);
+}
+
+
+/* decode_on_message */
+static void _decode_on_message(j_common_ptr jpeg, int level)
+{
+	/* corrupt frames are frequent with MJPEG, do not flood stderr */
+	(void) jpeg;
+	(void) level;
+}
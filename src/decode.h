@@ -0,0 +1,52 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Camera */
+/* Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ITS AUTHORS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+
+#ifndef CAMERA_DECODE_H
+# define CAMERA_DECODE_H
+
+
+/* CameraDecode */
+/* public */
+/* types */
+typedef struct _CameraDecode CameraDecode;
+
+
+/* functions */
+CameraDecode * cameradecode_new(void);
+void cameradecode_delete(CameraDecode * decode);
+
+/* useful */
+unsigned int cameradecode_mjpeg_shrink(unsigned int src_width,
+		unsigned int src_height, unsigned int dst_width,
+		unsigned int dst_height);
+int cameradecode_mjpeg(CameraDecode * decode, CameraConvertFormat format,
+		unsigned int shrink, unsigned char const * src, size_t src_size,
+		unsigned char * dst, size_t dst_stride,
+		unsigned int width, unsigned int height);
+
+#endif /* !CAMERA_DECODE_H */
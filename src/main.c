@@ -27,6 +27,8 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
 #include <locale.h>
 #include <libintl.h>
 #include <gtk/gtk.h>
@@ -59,7 +61,7 @@
 /* private */
 /* prototypes */
 static int _camera(int embedded, char const * device, int hflip, int vflip,
-		int ratio, char const * overlay);
+		int ratio, int framerate, char const * overlay);
 
 static int _error(char const * message, int ret);
 static int _usage(void);
@@ -68,18 +70,19 @@ static int _usage(void);
 /* functions */
 /* camera */
 static int _camera_embedded(char const * device, int hflip, int vflip,
-		int ratio, char const * overlay);
+		int ratio, int framerate, char const * overlay);
 #if defined(GDK_WINDOWING_X11)
 static void _embedded_on_embedded(gpointer data);
 #endif
 
 static int _camera(int embedded, char const * device, int hflip, int vflip,
-		int ratio, char const * overlay)
+		int ratio, int framerate, char const * overlay)
 {
 	CameraWindow * camera;
 
 	if(embedded != 0)
-		return _camera_embedded(device, hflip, vflip, ratio, overlay);
+		return _camera_embedded(device, hflip, vflip, ratio, framerate,
+				overlay);
 	if((camera = camerawindow_new(device)) == NULL)
 		return error_print(PACKAGE);
 	camerawindow_load(camera);
@@ -89,6 +92,8 @@ static int _camera(int embedded, char const * device, int hflip, int vflip,
 		camerawindow_set_vflip(camera, vflip ? TRUE : FALSE);
 	if(ratio >= 0)
 		camerawindow_set_aspect_ratio(camera, ratio ? TRUE : FALSE);
+	if(framerate >= 0)
+		camerawindow_set_framerate(camera, framerate);
 	if(overlay != NULL)
 		camerawindow_add_overlay(camera, overlay, 50);
 	gtk_main();
@@ -97,13 +102,14 @@ static int _camera(int embedded, char const * device, int hflip, int vflip,
 }
 
 static int _camera_embedded(char const * device, int hflip, int vflip,
-		int ratio, char const * overlay)
+		int ratio, int framerate, char const * overlay)
 {
 #if !defined(GDK_WINDOWING_X11)
 	(void) device;
 	(void) hflip;
 	(void) vflip;
 	(void) ratio;
+	(void) framerate;
 	(void) overlay;
 
 	error_set_code(-ENOSYS, "%s", strerror(ENOSYS));
@@ -130,6 +136,8 @@ static int _camera_embedded(char const * device, int hflip, int vflip,
 		camera_set_vflip(camera, vflip ? TRUE : FALSE);
 	if(ratio >= 0)
 		camera_set_aspect_ratio(camera, ratio ? TRUE : FALSE);
+	if(framerate >= 0)
+		camera_set_framerate(camera, framerate);
 	if(overlay != NULL)
 		camera_add_overlay(camera, overlay, 50);
 	widget = camera_get_widget(camera);
@@ -166,8 +174,9 @@ static int _error(char const * message, int ret)
 /* usage */
 static int _usage(void)
 {
-	fprintf(stderr, _("Usage: %s [-d device][-O filename][-HhRrVvx]\n"
-"  -d	Video device to open\n"
+	fprintf(stderr, _("Usage: %s [-d device][-f rate][-O filename][-HhRrVvx]\n"
+"  -d	Video device to open (\"test\" for a test pattern, or a recording)\n"
+"  -f	Frames per second, up to 240 (0 for the default)\n"
 "  -H	Flip horizontally\n"
 "  -h	Do not flip horizontally\n"
 "  -O	Use this file as an overlay\n"
@@ -191,19 +200,31 @@ int main(int argc, char * argv[])
 	int hflip = -1;
 	int vflip = -1;
 	int ratio = -1;
+	int framerate = -1;
+	long l;
 	char const * overlay = NULL;
+	char * p;
 
 	if(setlocale(LC_ALL, "") == NULL)
 		_error("setlocale", 1);
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	gtk_init(&argc, &argv);
-	while((o = getopt(argc, argv, "d:HhO:RrVvx")) != -1)
+	while((o = getopt(argc, argv, "d:f:HhO:RrVvx")) != -1)
 		switch(o)
 		{
 			case 'd':
 				device = optarg;
 				break;
+			case 'f':
+				errno = 0;
+				l = strtol(optarg, &p, 10);
+				if(optarg[0] == '\0' || *p != '\0'
+						|| errno == ERANGE
+						|| l < 0 || l > 240)
+					return _usage();
+				framerate = l;
+				break;
 			case 'H':
 				hflip = 1;
 				break;
@@ -233,6 +254,6 @@ int main(int argc, char * argv[])
 		}
 	if(optind != argc)
 		return _usage();
-	return (_camera(embedded, device, hflip, vflip, ratio, overlay) == 0)
-		? 0 : 2;
+	return (_camera(embedded, device, hflip, vflip, ratio, framerate,
+				overlay) == 0) ? 0 : 2;
 }
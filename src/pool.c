@@ -0,0 +1,255 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Camera */
+/* Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ITS AUTHORS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <System.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "pool.h"
+
+
+/* CameraPool */
+/* private */
+/* constants */
+/* enough for every step of a refresh */
+#define CAMERAPOOL_SIZE		8
+/* enough for every capture buffer */
+#define CAMERAPOOL_BUFFERS	64
+/* the usual size of huge pages */
+#define CAMERAPOOL_HUGE_SIZE	(2 * 1024 * 1024)
+
+
+/* protected */
+/* types */
+typedef struct _CameraPoolBuffer
+{
+	void * data;
+	size_t size;
+	gboolean huge;
+	gboolean used;
+} CameraPoolBuffer;
+
+struct _CameraPool
+{
+	/* idle pixbufs, least recently used first */
+	GdkPixbuf * pixbufs[CAMERAPOOL_SIZE];
+	size_t pixbufs_cnt;
+
+	/* memory for capturing, in use or idle */
+	CameraPoolBuffer buffers[CAMERAPOOL_BUFFERS];
+	size_t buffers_cnt;
+};
+
+
+/* prototypes */
+static void _camerapool_release(CameraPool * pool, gboolean all);
+
+
+/* public */
+/* functions */
+/* camerapool_new */
+CameraPool * camerapool_new(void)
+{
+	CameraPool * pool;
+
+	if((pool = object_new(sizeof(*pool))) == NULL)
+		return NULL;
+	pool->pixbufs_cnt = 0;
+	pool->buffers_cnt = 0;
+	return pool;
+}
+
+
+/* camerapool_delete */
+void camerapool_delete(CameraPool * pool)
+{
+	camerapool_flush(pool);
+	_camerapool_release(pool, TRUE);
+	object_delete(pool);
+}
+
+
+/* useful */
+/* camerapool_get */
+GdkPixbuf * camerapool_get(CameraPool * pool, int width, int height,
+		gboolean alpha)
+{
+	GdkPixbuf * pixbuf;
+	size_t i;
+
+	/* prefer the pixbuf used most recently */
+	for(i = pool->pixbufs_cnt; i > 0; i--)
+	{
+		pixbuf = pool->pixbufs[i - 1];
+		if(gdk_pixbuf_get_width(pixbuf) != width
+				|| gdk_pixbuf_get_height(pixbuf) != height
+				|| gdk_pixbuf_get_has_alpha(pixbuf) != alpha)
+			continue;
+		memmove(&pool->pixbufs[i - 1], &pool->pixbufs[i],
+				sizeof(*pool->pixbufs)
+				* (pool->pixbufs_cnt - i));
+		pool->pixbufs_cnt--;
+		return pixbuf;
+	}
+	if((pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, alpha, 8, width,
+					height)) == NULL)
+		error_set_code(-ENOMEM, "%s", strerror(ENOMEM));
+	return pixbuf;
+}
+
+
+/* camerapool_alloc */
+static void * _alloc_map(size_t size, gboolean huge);
+
+void * camerapool_alloc(CameraPool * pool, size_t size, gboolean huge)
+{
+	CameraPoolBuffer * buffer;
+	size_t page;
+	size_t i;
+
+	page = huge ? CAMERAPOOL_HUGE_SIZE : (size_t)sysconf(_SC_PAGESIZE);
+	size = (size + page - 1) / page * page;
+	/* reuse the memory released if possible */
+	for(i = 0; i < pool->buffers_cnt; i++)
+	{
+		buffer = &pool->buffers[i];
+		if(buffer->used == FALSE && buffer->size == size
+				&& buffer->huge == huge)
+		{
+			buffer->used = TRUE;
+			return buffer->data;
+		}
+	}
+	if(pool->buffers_cnt == CAMERAPOOL_BUFFERS)
+	{
+		/* forget the memory released */
+		_camerapool_release(pool, FALSE);
+		if(pool->buffers_cnt == CAMERAPOOL_BUFFERS)
+		{
+			error_set_code(-ENOMEM, "%s", strerror(ENOMEM));
+			return NULL;
+		}
+	}
+	buffer = &pool->buffers[pool->buffers_cnt];
+	if((buffer->data = _alloc_map(size, huge)) == NULL)
+		return NULL;
+	buffer->size = size;
+	buffer->huge = huge;
+	buffer->used = TRUE;
+	pool->buffers_cnt++;
+	return buffer->data;
+}
+
+static void * _alloc_map(size_t size, gboolean huge)
+{
+	const int prot = PROT_READ | PROT_WRITE;
+	const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void * ret;
+
+#ifdef MAP_HUGETLB
+	/* huge pages must have been reserved by the administrator */
+	if(huge && (ret = mmap(NULL, size, prot, flags | MAP_HUGETLB, -1, 0))
+			!= MAP_FAILED)
+		return ret;
+#endif
+	if((ret = mmap(NULL, size, prot, flags, -1, 0)) == MAP_FAILED)
+	{
+		error_set_code(-errno, "%s", strerror(errno));
+		return NULL;
+	}
+#ifdef MADV_HUGEPAGE
+	/* otherwise let the kernel merge the pages if it can */
+	if(huge)
+		madvise(ret, size, MADV_HUGEPAGE);
+#endif
+	return ret;
+}
+
+
+/* camerapool_free */
+void camerapool_free(CameraPool * pool, void * buffer)
+{
+	size_t i;
+
+	if(buffer == NULL)
+		return;
+	for(i = 0; i < pool->buffers_cnt; i++)
+		if(pool->buffers[i].data == buffer)
+		{
+			pool->buffers[i].used = FALSE;
+			return;
+		}
+}
+
+
+/* camerapool_put */
+void camerapool_put(CameraPool * pool, GdkPixbuf * pixbuf)
+{
+	if(pixbuf == NULL)
+		return;
+	if(pool->pixbufs_cnt == CAMERAPOOL_SIZE)
+	{
+		/* forget the least recently used */
+		g_object_unref(pool->pixbufs[0]);
+		memmove(&pool->pixbufs[0], &pool->pixbufs[1],
+				sizeof(*pool->pixbufs)
+				* --pool->pixbufs_cnt);
+	}
+	pool->pixbufs[pool->pixbufs_cnt++] = pixbuf;
+}
+
+
+/* camerapool_flush */
+void camerapool_flush(CameraPool * pool)
+{
+	for(; pool->pixbufs_cnt > 0; pool->pixbufs_cnt--)
+		g_object_unref(pool->pixbufs[pool->pixbufs_cnt - 1]);
+	/* keep the memory still in use */
+	_camerapool_release(pool, FALSE);
+}
+
+
+/* private */
+/* functions */
+/* camerapool_release */
+static void _camerapool_release(CameraPool * pool, gboolean all)
+{
+	size_t i;
+	CameraPoolBuffer * buffer;
+
+	for(i = pool->buffers_cnt; i > 0; i--)
+	{
+		buffer = &pool->buffers[i - 1];
+		if(buffer->used && !all)
+			continue;
+		munmap(buffer->data, buffer->size);
+		memmove(buffer, &buffer[1], sizeof(*buffer)
+				* (--pool->buffers_cnt - (i - 1)));
+	}
+}
@@ -0,0 +1,760 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Camera */
+/* Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ITS AUTHORS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <libintl.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include <glib.h>
+#include <System.h>
+#include "convert.h"
+#include "source.h"
+#define _(string) gettext(string)
+
+
+/* CameraSource */
+/* private */
+/* types */
+typedef struct _CameraSourceBackend
+{
+	char const * name;
+	int (*probe)(char const * device);
+	int (*init)(CameraSource * source, char const * device);
+	void (*destroy)(CameraSource * source);
+	int (*read)(CameraSource * source, unsigned char * buffer,
+			size_t size, size_t * used);
+	/* microseconds from the first frame, if not regular */
+	gint64 (*due)(CameraSource * source, unsigned long frame);
+} CameraSourceBackend;
+
+typedef struct _CameraSourceError
+{
+	struct jpeg_error_mgr error;
+	jmp_buf jmp;
+	/* frames are read from the capture thread, away from libSystem */
+	char message[JMSG_LENGTH_MAX];
+} CameraSourceError;
+
+struct _CameraSource
+{
+	CameraSourceBackend const * backend;
+	CameraSourceFormat format;
+
+	/* pacing, in microseconds */
+	gboolean realtime;
+	gint64 start;
+	gint64 interval;
+	unsigned long frame;
+	/* 0 if unlimited */
+	unsigned long frames;
+
+	/* test patterns, as YUV triplets */
+	unsigned char * pattern[2];
+	struct jpeg_compress_struct jpeg;
+	CameraSourceError error;
+	gboolean jpeg_valid;
+
+	/* recorded sessions */
+	unsigned char * map;
+	size_t map_size;
+	size_t index;
+};
+
+/* recorded sessions consist of a header, the frames, then an index with an
+ * entry for every frame, every integer being stored in little endian */
+typedef struct _CameraSourceFileHeader
+{
+	char magic[8];
+	uint32_t fourcc;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint64_t frames;
+	/* the offset of the index */
+	uint64_t index;
+} CameraSourceFileHeader;
+
+typedef struct _CameraSourceFileEntry
+{
+	uint64_t offset;
+	uint64_t size;
+	/* in microseconds */
+	uint64_t timestamp;
+} CameraSourceFileEntry;
+
+
+/* constants */
+#define SOURCE_FILE_MAGIC	"CAMRAW01"
+#define SOURCE_SIZE_MAX		8192
+/* the columns scrolled by every frame */
+#define SOURCE_TEST_STEP	4
+
+/* 75% colour bars, as YUV */
+static const unsigned char _source_bars[8][3] =
+{
+	{ 180, 128, 128 },	/* white */
+	{ 162,  44, 142 },	/* yellow */
+	{ 131, 156,  44 },	/* cyan */
+	{ 112,  72,  58 },	/* green */
+	{  84, 184, 198 },	/* magenta */
+	{  65, 100, 212 },	/* red */
+	{  35, 212, 114 },	/* blue */
+	{  16, 128, 128 }	/* black */
+};
+
+
+/* prototypes */
+static gint64 _source_due(CameraSource * source, unsigned long frame);
+static int _source_error(CameraSource * source, char const * message);
+
+/* recorded sessions */
+static char * _file_name(char const * device, unsigned long * frame);
+static int _file_probe(char const * device);
+static int _file_init(CameraSource * source, char const * device);
+static void _file_destroy(CameraSource * source);
+static int _file_read(CameraSource * source, unsigned char * buffer,
+		size_t size, size_t * used);
+static gint64 _file_due(CameraSource * source, unsigned long frame);
+
+/* test patterns */
+static int _test_probe(char const * device);
+static int _test_init(CameraSource * source, char const * device);
+static void _test_destroy(CameraSource * source);
+static int _test_read(CameraSource * source, unsigned char * buffer,
+		size_t size, size_t * used);
+
+/* callbacks */
+static void _source_on_error(j_common_ptr jpeg);
+static void _source_on_message(j_common_ptr jpeg, int level);
+
+
+/* variables */
+static const CameraSourceBackend _source_backends[] =
+{
+	{ "test", _test_probe, _test_init, _test_destroy, _test_read, NULL },
+	{ "file", _file_probe, _file_init, _file_destroy, _file_read,
+		_file_due }
+};
+
+
+/* public */
+/* functions */
+/* camerasource_probe */
+int camerasource_probe(char const * device)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(_source_backends) / sizeof(*_source_backends);
+			i++)
+		if(_source_backends[i].probe(device))
+			return 1;
+	return 0;
+}
+
+
+/* camerasource_new */
+CameraSource * camerasource_new(char const * device)
+{
+	CameraSource * source;
+	size_t i;
+
+	if((source = object_new(sizeof(*source))) == NULL)
+		return NULL;
+	memset(source, 0, sizeof(*source));
+	for(i = 0; i < sizeof(_source_backends) / sizeof(*_source_backends);
+			i++)
+		if(_source_backends[i].probe(device))
+		{
+			source->backend = &_source_backends[i];
+			break;
+		}
+	if(source->backend == NULL)
+	{
+		error_set_code(1, "%s: %s", device, _("Unknown source"));
+		object_delete(source);
+		return NULL;
+	}
+	if(source->backend->init(source, device) != 0)
+	{
+		camerasource_delete(source);
+		return NULL;
+	}
+	source->interval = (source->format.numerator != 0
+			&& source->format.denominator != 0)
+		? (gint64)source->format.numerator * G_USEC_PER_SEC
+		/ source->format.denominator : 0;
+	source->realtime = TRUE;
+	/* the backend may start further in the stream */
+	source->start = g_get_monotonic_time()
+		- _source_due(source, source->frame);
+	return source;
+}
+
+
+/* camerasource_delete */
+void camerasource_delete(CameraSource * source)
+{
+	source->backend->destroy(source);
+	object_delete(source);
+}
+
+
+/* accessors */
+/* camerasource_get_name */
+char const * camerasource_get_name(CameraSource * source)
+{
+	return source->backend->name;
+}
+
+
+/* camerasource_get_error */
+char const * camerasource_get_error(CameraSource * source)
+{
+	return source->error.message;
+}
+
+
+/* camerasource_get_format */
+void camerasource_get_format(CameraSource * source,
+		CameraSourceFormat * format)
+{
+	*format = source->format;
+}
+
+
+/* camerasource_get_timeout */
+int camerasource_get_timeout(CameraSource * source)
+{
+	gint64 due;
+
+	if(source->realtime == FALSE)
+		return 0;
+	due = source->start + _source_due(source, source->frame)
+		- g_get_monotonic_time();
+	/* rounded up, to avoid waking up early */
+	return (due > 0) ? (due + 999) / 1000 : 0;
+}
+
+
+/* camerasource_set_realtime */
+void camerasource_set_realtime(CameraSource * source, int realtime)
+{
+	source->realtime = realtime ? TRUE : FALSE;
+	/* keep the pace from the current frame */
+	source->start = g_get_monotonic_time()
+		- _source_due(source, source->frame);
+}
+
+
+/* useful */
+/* camerasource_read */
+int camerasource_read(CameraSource * source, unsigned char * buffer,
+		size_t size, size_t * used)
+{
+	int ret;
+
+	if(source->frames > 0 && source->frame >= source->frames)
+		return _source_error(source, _("End of stream"));
+	if(camerasource_get_timeout(source) > 0)
+		return 1;
+	if((ret = source->backend->read(source, buffer, size, used)) == 0)
+		source->frame++;
+	return ret;
+}
+
+
+/* private */
+/* functions */
+/* source_due */
+static gint64 _source_due(CameraSource * source, unsigned long frame)
+{
+	if(source->backend->due != NULL)
+		return source->backend->due(source, frame);
+	return source->interval * frame;
+}
+
+
+/* source_error */
+static int _source_error(CameraSource * source, char const * message)
+{
+	snprintf(source->error.message, sizeof(source->error.message), "%s",
+			message);
+	return -1;
+}
+
+
+/* recorded sessions */
+/* file_name */
+static char * _file_name(char const * device, unsigned long * frame)
+{
+	char * ret;
+	char * p;
+	char * q;
+	struct stat st;
+
+	*frame = 0;
+	if((ret = strdup(device)) == NULL)
+		return NULL;
+	/* FILENAME@FRAME, unless the file is really called this way */
+	if(stat(ret, &st) == 0 || (p = strrchr(ret, '@')) == NULL
+			|| p[1] < '0' || p[1] > '9')
+		return ret;
+	errno = 0;
+	*frame = strtoul(&p[1], &q, 10);
+	if(*q != '\0' || errno != 0)
+		*frame = 0;
+	else
+		*p = '\0';
+	return ret;
+}
+
+
+/* file_probe */
+static int _file_probe(char const * device)
+{
+	int ret;
+	char * filename;
+	unsigned long frame;
+	struct stat st;
+
+	if((filename = _file_name(device, &frame)) == NULL)
+		return 0;
+	/* video devices are character devices */
+	ret = (stat(filename, &st) == 0 && S_ISREG(st.st_mode)) ? 1 : 0;
+	free(filename);
+	return ret;
+}
+
+
+/* file_init */
+static void _file_entry(CameraSource * source, unsigned long frame,
+		CameraSourceFileEntry * entry);
+
+static int _file_init(CameraSource * source, char const * device)
+{
+	CameraSourceFormat * format = &source->format;
+	CameraSourceFileHeader header;
+	CameraSourceFileEntry entry;
+	CameraSourceFileEntry last;
+	char * filename;
+	unsigned long frame;
+	int fd;
+	struct stat st;
+	unsigned long i;
+
+	if((filename = _file_name(device, &frame)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	if((fd = open(filename, O_RDONLY)) < 0)
+	{
+		error_set_code(1, "%s: %s", device, strerror(errno));
+		free(filename);
+		return -1;
+	}
+	free(filename);
+	if(fstat(fd, &st) != 0 || (source->map = mmap(NULL, st.st_size,
+					PROT_READ, MAP_SHARED, fd, 0))
+			== MAP_FAILED)
+	{
+		source->map = NULL;
+		error_set_code(1, "%s: %s", device, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	/* the mapping remains valid */
+	close(fd);
+	source->map_size = st.st_size;
+	if(source->map_size < sizeof(header))
+		return -error_set_code(1, "%s: %s", device,
+				_("Not a recorded session"));
+	memcpy(&header, source->map, sizeof(header));
+	source->frames = GUINT64_FROM_LE(header.frames);
+	source->index = GUINT64_FROM_LE(header.index);
+	format->fourcc = GUINT32_FROM_LE(header.fourcc);
+	format->width = GUINT32_FROM_LE(header.width);
+	format->height = GUINT32_FROM_LE(header.height);
+	format->stride = GUINT32_FROM_LE(header.stride);
+	if(memcmp(header.magic, SOURCE_FILE_MAGIC, sizeof(header.magic))
+			!= 0 || source->frames == 0
+			|| source->index > source->map_size
+			|| (source->map_size - source->index) / sizeof(entry)
+			< source->frames)
+		return -error_set_code(1, "%s: %s", device,
+				_("Not a recorded session"));
+	/* the buffers must hold the largest frame */
+	for(i = 0, format->size = 0; i < source->frames; i++)
+	{
+		_file_entry(source, i, &entry);
+		if(entry.offset > source->map_size
+				|| entry.size > source->map_size
+				- entry.offset)
+			return -error_set_code(1, "%s: %s", device,
+					_("Corrupted recorded session"));
+		format->size = MAX(format->size, entry.size);
+	}
+	/* the average frame rate */
+	_file_entry(source, 0, &entry);
+	_file_entry(source, source->frames - 1, &last);
+	format->numerator = (source->frames > 1 && last.timestamp
+			> entry.timestamp) ? (last.timestamp - entry.timestamp)
+		/ (source->frames - 1) : 0;
+	format->denominator = (format->numerator > 0) ? G_USEC_PER_SEC : 0;
+	/* start from the frame requested, if any */
+	if(frame >= source->frames)
+		return -error_set_code(1, "%s: %s", device, _("Invalid frame"));
+	source->frame = frame;
+	return 0;
+}
+
+static void _file_entry(CameraSource * source, unsigned long frame,
+		CameraSourceFileEntry * entry)
+{
+	memcpy(entry, &source->map[source->index + frame * sizeof(*entry)],
+			sizeof(*entry));
+	entry->offset = GUINT64_FROM_LE(entry->offset);
+	entry->size = GUINT64_FROM_LE(entry->size);
+	entry->timestamp = GUINT64_FROM_LE(entry->timestamp);
+}
+
+
+/* file_destroy */
+static void _file_destroy(CameraSource * source)
+{
+	if(source->map != NULL)
+		munmap(source->map, source->map_size);
+}
+
+
+/* file_read */
+static int _file_read(CameraSource * source, unsigned char * buffer,
+		size_t size, size_t * used)
+{
+	CameraSourceFileEntry entry;
+
+	_file_entry(source, source->frame, &entry);
+	if(entry.size > size)
+		return _source_error(source, _("Buffer too small"));
+	memcpy(buffer, &source->map[entry.offset], entry.size);
+	*used = entry.size;
+	return 0;
+}
+
+
+/* file_due */
+static gint64 _file_due(CameraSource * source, unsigned long frame)
+{
+	CameraSourceFileEntry first;
+	CameraSourceFileEntry entry;
+
+	/* at the original timestamps */
+	_file_entry(source, 0, &first);
+	_file_entry(source, MIN(frame, source->frames - 1), &entry);
+	return (entry.timestamp > first.timestamp)
+		? entry.timestamp - first.timestamp : 0;
+}
+
+
+/* test patterns */
+/* test_probe */
+static int _test_probe(char const * device)
+{
+	return (strcmp(device, "test") == 0 || strncmp(device, "test:", 5) == 0)
+		? 1 : 0;
+}
+
+
+/* test_init */
+static int _init_option(CameraSource * source, char const * option);
+
+static int _test_init(CameraSource * source, char const * device)
+{
+	CameraSourceFormat * format = &source->format;
+	char * options;
+	char * option;
+	char * p;
+	size_t i;
+	int ret = 0;
+
+	/* YUYV at 640x480 and 30 frames per second by default */
+	format->fourcc = CAMERACONVERT_FOURCC('Y', 'U', 'Y', 'V');
+	format->width = 640;
+	format->height = 480;
+	format->numerator = 1;
+	format->denominator = 30;
+	/* test:FORMAT:WIDTHxHEIGHT@RATE, every option being optional */
+	if(device[4] == ':')
+	{
+		if((options = strdup(&device[5])) == NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		for(option = strtok_r(options, ":", &p); option != NULL;
+				option = strtok_r(NULL, ":", &p))
+			if((ret = _init_option(source, option)) != 0)
+			{
+				error_set_code(1, "%s: %s", device,
+						_("Invalid test pattern"));
+				break;
+			}
+		free(options);
+		if(ret != 0)
+			return ret;
+	}
+	/* the chrominance is shared by pairs of pixels and rows */
+	format->width &= ~1U;
+	format->height &= ~1U;
+	switch(format->fourcc)
+	{
+		case CAMERACONVERT_FOURCC('N', 'V', '1', '2'):
+			format->stride = format->width;
+			format->size = format->stride * format->height * 3 / 2;
+			break;
+		case CAMERACONVERT_FOURCC('M', 'J', 'P', 'G'):
+			format->stride = 0;
+			/* much more than the patterns need */
+			format->size = (size_t)format->width * format->height
+				* 2;
+			break;
+		default:
+			format->stride = format->width * 2;
+			format->size = format->stride * format->height;
+			break;
+	}
+	for(i = 0; i < sizeof(source->pattern) / sizeof(*source->pattern);
+			i++)
+		if((source->pattern[i] = malloc(format->width * 3)) == NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+	if(format->fourcc != CAMERACONVERT_FOURCC('M', 'J', 'P', 'G'))
+		return 0;
+	source->jpeg.err = jpeg_std_error(&source->error.error);
+	source->error.error.error_exit = _source_on_error;
+	source->error.error.emit_message = _source_on_message;
+	if(setjmp(source->error.jmp) != 0)
+		return -error_set_code(1, "%s", source->error.message);
+	jpeg_create_compress(&source->jpeg);
+	source->jpeg_valid = TRUE;
+	return 0;
+}
+
+static int _init_option(CameraSource * source, char const * option)
+{
+	CameraSourceFormat * format = &source->format;
+	unsigned long width;
+	unsigned long height;
+	unsigned long rate;
+	char * p;
+
+	if(strcmp(option, "yuyv") == 0)
+		format->fourcc = CAMERACONVERT_FOURCC('Y', 'U', 'Y', 'V');
+	else if(strcmp(option, "nv12") == 0)
+		format->fourcc = CAMERACONVERT_FOURCC('N', 'V', '1', '2');
+	else if(strcmp(option, "mjpeg") == 0)
+		format->fourcc = CAMERACONVERT_FOURCC('M', 'J', 'P', 'G');
+	else
+	{
+		if(option[0] >= '1' && option[0] <= '9')
+		{
+			/* the size */
+			if((width = strtoul(option, &p, 10)) < 2
+					|| width > SOURCE_SIZE_MAX
+					|| *p != 'x' || p[1] < '1' || p[1] > '9'
+					|| (height = strtoul(&p[1], &p, 10))
+					< 2 || height > SOURCE_SIZE_MAX)
+				return -1;
+			format->width = width;
+			format->height = height;
+			option = p;
+		}
+		if(option[0] == '@')
+		{
+			/* the frame rate, 0 for as fast as possible */
+			if(option[1] < '0' || option[1] > '9'
+					|| (rate = strtoul(&option[1], &p, 10))
+					> 1000)
+				return -1;
+			format->numerator = (rate > 0) ? 1 : 0;
+			format->denominator = rate;
+			option = p;
+		}
+		if(option[0] != '\0')
+			return -1;
+	}
+	return 0;
+}
+
+
+/* test_destroy */
+static void _test_destroy(CameraSource * source)
+{
+	size_t i;
+
+	if(source->jpeg_valid)
+		jpeg_destroy_compress(&source->jpeg);
+	for(i = 0; i < sizeof(source->pattern) / sizeof(*source->pattern);
+			i++)
+		free(source->pattern[i]);
+}
+
+
+/* test_read */
+static void _read_pattern(CameraSource * source);
+static int _read_mjpeg(CameraSource * source, unsigned char * buffer,
+		size_t size, size_t * used);
+
+static int _test_read(CameraSource * source, unsigned char * buffer,
+		size_t size, size_t * used)
+{
+	CameraSourceFormat * format = &source->format;
+	unsigned char const * src;
+	unsigned char * dst;
+	unsigned int x;
+	unsigned int y;
+
+	_read_pattern(source);
+	if(format->fourcc == CAMERACONVERT_FOURCC('M', 'J', 'P', 'G'))
+		return _read_mjpeg(source, buffer, size, used);
+	if(size < format->size)
+		return _source_error(source, _("Buffer too small"));
+	/* the bars on top, the ramp on the last quarter */
+	for(y = 0; y < format->height; y++)
+	{
+		src = source->pattern[(y < format->height / 4 * 3) ? 0 : 1];
+		dst = &buffer[format->stride * y];
+		if(format->fourcc == CAMERACONVERT_FOURCC('N', 'V', '1', '2'))
+			for(x = 0; x < format->width; x++)
+				dst[x] = src[x * 3];
+		else
+			for(x = 0; x < format->width; x += 2, src += 6)
+			{
+				dst[x * 2] = src[0];
+				dst[x * 2 + 1] = src[1];
+				dst[x * 2 + 2] = src[3];
+				dst[x * 2 + 3] = src[2];
+			}
+	}
+	if(format->fourcc == CAMERACONVERT_FOURCC('N', 'V', '1', '2'))
+		/* the chrominance interleaved, for every pair of rows */
+		for(y = 0; y < format->height / 2; y++)
+		{
+			src = source->pattern[(y * 2 < format->height / 4 * 3)
+				? 0 : 1];
+			dst = &buffer[format->stride * (format->height + y)];
+			for(x = 0; x < format->width; x += 2, src += 6)
+			{
+				dst[x] = src[1];
+				dst[x + 1] = src[2];
+			}
+		}
+	*used = format->size;
+	return 0;
+}
+
+static void _read_pattern(CameraSource * source)
+{
+	unsigned int width = source->format.width;
+	unsigned int shift = (source->frame * SOURCE_TEST_STEP) % width;
+	unsigned char * bars = source->pattern[0];
+	unsigned char * ramp = source->pattern[1];
+	unsigned int x;
+	unsigned int i;
+
+	/* scroll both to the left over time */
+	for(x = 0; x < width; x++)
+	{
+		i = (x + shift) % width;
+		memcpy(&bars[x * 3], _source_bars[i * 8 / width], 3);
+		ramp[x * 3] = 16 + i * 219 / width;
+		ramp[x * 3 + 1] = 128;
+		ramp[x * 3 + 2] = 128;
+	}
+}
+
+static int _read_mjpeg(CameraSource * source, unsigned char * buffer,
+		size_t size, size_t * used)
+{
+	struct jpeg_compress_struct * jpeg = &source->jpeg;
+	unsigned char * out = buffer;
+	unsigned long out_size = size;
+	JSAMPROW row;
+
+	if(setjmp(source->error.jmp) != 0)
+	{
+		jpeg_abort_compress(jpeg);
+		if(out != buffer)
+			free(out);
+		return -1;
+	}
+	/* libjpeg only allocates memory when the buffer is too small */
+	jpeg_mem_dest(jpeg, &out, &out_size);
+	jpeg->image_width = source->format.width;
+	jpeg->image_height = source->format.height;
+	jpeg->input_components = 3;
+	jpeg->in_color_space = JCS_YCbCr;
+	jpeg_set_defaults(jpeg);
+	jpeg_start_compress(jpeg, TRUE);
+	while(jpeg->next_scanline < jpeg->image_height)
+	{
+		row = source->pattern[(jpeg->next_scanline
+				< jpeg->image_height / 4 * 3) ? 0 : 1];
+		jpeg_write_scanlines(jpeg, &row, 1);
+	}
+	jpeg_finish_compress(jpeg);
+	if(out != buffer)
+	{
+		free(out);
+		return _source_error(source, _("Buffer too small"));
+	}
+	*used = out_size;
+	return 0;
+}
+
+
+/* callbacks */
+/* source_on_error */
+static void _source_on_error(j_common_ptr jpeg)
+{
+	CameraSourceError * error = (CameraSourceError *)jpeg->err;
+
+	/* reported by the caller */
+	error->error.format_message(jpeg, error->message);
+	longjmp(error->jmp, 1);
+}
+
+
+/* source_on_message */
+static void _source_on_message(j_common_ptr jpeg, int level)
+{
+	(void) jpeg;
+	(void) level;
+}
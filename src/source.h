@@ -0,0 +1,81 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Camera */
+/* Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ITS AUTHORS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+
+#ifndef CAMERA_SOURCE_H
+# define CAMERA_SOURCE_H
+
+# include <stddef.h>
+# include <stdint.h>
+
+
+/* CameraSource */
+/* public */
+/* types */
+typedef struct _CameraSource CameraSource;
+
+typedef struct _CameraSourceFormat
+{
+	uint32_t fourcc;
+	unsigned int width;
+	unsigned int height;
+	/* 0 when compressed */
+	size_t stride;
+	/* the largest frame possible */
+	size_t size;
+	/* 0/0 when as fast as possible */
+	unsigned int numerator;
+	unsigned int denominator;
+} CameraSourceFormat;
+
+
+/* functions */
+/* whether a device name designates a source rather than a device */
+int camerasource_probe(char const * device);
+
+CameraSource * camerasource_new(char const * device);
+void camerasource_delete(CameraSource * source);
+
+/* accessors */
+/* the reason why camerasource_read() failed last */
+char const * camerasource_get_error(CameraSource * source);
+char const * camerasource_get_name(CameraSource * source);
+void camerasource_get_format(CameraSource * source,
+		CameraSourceFormat * format);
+/* milliseconds until the next frame is due */
+int camerasource_get_timeout(CameraSource * source);
+
+/* deliver the frames on time, or as fast as possible */
+void camerasource_set_realtime(CameraSource * source, int realtime);
+
+/* useful */
+/* 0 with a frame, 1 when none is due yet, or negative on errors, without
+ * setting the error code as it may be called from any thread */
+int camerasource_read(CameraSource * source, unsigned char * buffer,
+		size_t size, size_t * used);
+
+#endif /* !CAMERA_SOURCE_H */
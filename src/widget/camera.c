@@ -29,9 +29,17 @@
 #include <System.h>
 #include <Desktop.h>
 #include "../overlay.h"
+#include "../convert.h"
+#include "../decode.h"
+#include "../pool.h"
+#include "../source.h"
 #include "../camera.h"
 
 #include "../overlay.c"
+#include "../convert.c"
+#include "../decode.c"
+#include "../pool.c"
+#include "../source.c"
 #include "../camera.c"
 
 
@@ -245,6 +245,13 @@ void camerawindow_set_aspect_ratio(CameraWindow * camera, gboolean ratio)
 }
 
 
+/* camerawindow_set_framerate */
+void camerawindow_set_framerate(CameraWindow * camera, unsigned int framerate)
+{
+	camera_set_framerate(camera->camera, framerate);
+}
+
+
 /* camerawindow_set_fullscreen */
 void camerawindow_set_fullscreen(CameraWindow * camera, int fullscreen)
 {
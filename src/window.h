@@ -43,6 +43,9 @@ void camerawindow_delete(CameraWindow * camera);
 /* accessors */
 void camerawindow_set_aspect_ratio(CameraWindow * camera, gboolean ratio);
 
+void camerawindow_set_framerate(CameraWindow * camera,
+		unsigned int framerate);
+
 void camerawindow_set_fullscreen(CameraWindow * camera, int fullscreen);
 
 void camerawindow_set_hflip(CameraWindow * camera, gboolean flip);
@@ -0,0 +1,1212 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Camera */
+/* Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ITS AUTHORS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+/* the kernels are private */
+#include "../src/convert.c"
+
+#ifndef PROGNAME
+# define PROGNAME	"convert"
+#endif
+
+
+/* private */
+/* types */
+typedef enum _TestFeature
+{
+	TF_NONE = 0,
+	TF_SSE2,
+	TF_SSSE3,
+	TF_AVX2,
+	TF_NEON
+} TestFeature;
+
+typedef struct _TestRow
+{
+	char const * name;
+	TestFeature feature;
+	CameraConvertKernel kernel;
+	CameraConvertFormat format;
+	CameraConvertRow row;
+	CameraConvertRow scalar;
+} TestRow;
+
+typedef struct _TestPlanar
+{
+	char const * name;
+	TestFeature feature;
+	CameraConvertFormat format;
+	CameraConvertPlanar planar;
+	CameraConvertPlanar scalar;
+} TestPlanar;
+
+typedef struct _TestReverse
+{
+	char const * name;
+	TestFeature feature;
+	CameraConvertFormat format;
+	CameraConvertReverse reverse;
+} TestReverse;
+
+typedef struct _TestBlend
+{
+	char const * name;
+	TestFeature feature;
+	CameraConvertBlend blend;
+} TestBlend;
+
+typedef struct _TestDecimate
+{
+	char const * name;
+	TestFeature feature;
+	CameraConvertFormat format;
+	unsigned int factor;
+	CameraConvertDecimate decimate;
+} TestDecimate;
+
+typedef struct _TestFrame
+{
+	uint32_t fourcc;
+	/* bytes per pixel in the first plane */
+	unsigned int bpp;
+} TestFrame;
+
+typedef struct _TestScale
+{
+	unsigned int src_width;
+	unsigned int src_height;
+	unsigned int dst_width;
+	unsigned int dst_height;
+} TestScale;
+
+
+/* constants */
+/* pixels in the rows converted exhaustively, one per value of luminance */
+#define TEST_WIDTH	256
+/* widths tried for the remainders of the vector kernels */
+#define TEST_WIDTHS	72
+/* room left after the rows, read by some of the vector kernels */
+#define TEST_SLACK	64
+#define TEST_CANARY	0xa5
+#define TEST_FOURCC_RGB24	CAMERACONVERT_FOURCC('R', 'G', 'B', '3')
+
+
+/* variables */
+static const TestRow _test_rows[] =
+{
+	{ "yuyv_rgb24", TF_NONE, CCK_YUYV, CCF_RGB24, _convert_yuyv_rgb24,
+		_convert_yuyv_rgb24 },
+	{ "yuyv_xrgb32", TF_NONE, CCK_YUYV, CCF_XRGB32, _convert_yuyv_xrgb32,
+		_convert_yuyv_xrgb32 },
+	{ "uyvy_rgb24", TF_NONE, CCK_UYVY, CCF_RGB24, _convert_uyvy_rgb24,
+		_convert_uyvy_rgb24 },
+	{ "uyvy_xrgb32", TF_NONE, CCK_UYVY, CCF_XRGB32, _convert_uyvy_xrgb32,
+		_convert_uyvy_xrgb32 },
+	{ "grey_rgb24", TF_NONE, CCK_GREY, CCF_RGB24, _convert_grey_rgb24,
+		_convert_grey_rgb24 },
+	{ "grey_xrgb32", TF_NONE, CCK_GREY, CCF_XRGB32, _convert_grey_xrgb32,
+		_convert_grey_xrgb32 },
+	{ "rgb24_rgb24", TF_NONE, CCK_RGB24, CCF_RGB24, _convert_rgb24_rgb24,
+		_convert_rgb24_rgb24 },
+	{ "rgb24_xrgb32", TF_NONE, CCK_RGB24, CCF_XRGB32,
+		_convert_rgb24_xrgb32, _convert_rgb24_xrgb32 },
+	{ "bgr24_rgb24", TF_NONE, CCK_BGR24, CCF_RGB24, _convert_bgr24_rgb24,
+		_convert_bgr24_rgb24 },
+	{ "bgr24_xrgb32", TF_NONE, CCK_BGR24, CCF_XRGB32,
+		_convert_bgr24_xrgb32, _convert_bgr24_xrgb32 },
+#if defined(CONVERT_X86)
+	{ "yuyv_rgb24_sse2", TF_SSE2, CCK_YUYV, CCF_RGB24,
+		_convert_yuyv_rgb24_sse2, _convert_yuyv_rgb24 },
+	{ "yuyv_rgb24_ssse3", TF_SSSE3, CCK_YUYV, CCF_RGB24,
+		_convert_yuyv_rgb24_ssse3, _convert_yuyv_rgb24 },
+	{ "yuyv_rgb24_avx2", TF_AVX2, CCK_YUYV, CCF_RGB24,
+		_convert_yuyv_rgb24_avx2, _convert_yuyv_rgb24 },
+	{ "yuyv_xrgb32_sse2", TF_SSE2, CCK_YUYV, CCF_XRGB32,
+		_convert_yuyv_xrgb32_sse2, _convert_yuyv_xrgb32 },
+	{ "yuyv_xrgb32_avx2", TF_AVX2, CCK_YUYV, CCF_XRGB32,
+		_convert_yuyv_xrgb32_avx2, _convert_yuyv_xrgb32 },
+	{ "uyvy_rgb24_ssse3", TF_SSSE3, CCK_UYVY, CCF_RGB24,
+		_convert_uyvy_rgb24_ssse3, _convert_uyvy_rgb24 },
+	{ "uyvy_xrgb32_sse2", TF_SSE2, CCK_UYVY, CCF_XRGB32,
+		_convert_uyvy_xrgb32_sse2, _convert_uyvy_xrgb32 },
+	{ "rgb24_xrgb32_ssse3", TF_SSSE3, CCK_RGB24, CCF_XRGB32,
+		_convert_rgb24_xrgb32_ssse3, _convert_rgb24_xrgb32 },
+	{ "bgr24_rgb24_ssse3", TF_SSSE3, CCK_BGR24, CCF_RGB24,
+		_convert_bgr24_rgb24_ssse3, _convert_bgr24_rgb24 },
+	{ "bgr24_xrgb32_ssse3", TF_SSSE3, CCK_BGR24, CCF_XRGB32,
+		_convert_bgr24_xrgb32_ssse3, _convert_bgr24_xrgb32 },
+#elif defined(CONVERT_NEON)
+	{ "yuyv_rgb24_neon", TF_NEON, CCK_YUYV, CCF_RGB24,
+		_convert_yuyv_rgb24_neon, _convert_yuyv_rgb24 },
+	{ "uyvy_rgb24_neon", TF_NEON, CCK_UYVY, CCF_RGB24,
+		_convert_uyvy_rgb24_neon, _convert_uyvy_rgb24 },
+	{ "bgr24_rgb24_neon", TF_NEON, CCK_BGR24, CCF_RGB24,
+		_convert_bgr24_rgb24_neon, _convert_bgr24_rgb24 },
+# if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	{ "yuyv_xrgb32_neon", TF_NEON, CCK_YUYV, CCF_XRGB32,
+		_convert_yuyv_xrgb32_neon, _convert_yuyv_xrgb32 },
+	{ "uyvy_xrgb32_neon", TF_NEON, CCK_UYVY, CCF_XRGB32,
+		_convert_uyvy_xrgb32_neon, _convert_uyvy_xrgb32 },
+	{ "rgb24_xrgb32_neon", TF_NEON, CCK_RGB24, CCF_XRGB32,
+		_convert_rgb24_xrgb32_neon, _convert_rgb24_xrgb32 },
+	{ "bgr24_xrgb32_neon", TF_NEON, CCK_BGR24, CCF_XRGB32,
+		_convert_bgr24_xrgb32_neon, _convert_bgr24_xrgb32 },
+# endif
+#endif
+};
+
+static const TestPlanar _test_planars[] =
+{
+	{ "yuv420_rgb24", TF_NONE, CCF_RGB24, _convert_yuv420_rgb24,
+		_convert_yuv420_rgb24 },
+	{ "yuv420_xrgb32", TF_NONE, CCF_XRGB32, _convert_yuv420_xrgb32,
+		_convert_yuv420_xrgb32 },
+#if defined(CONVERT_X86)
+	{ "yuv420_rgb24_ssse3", TF_SSSE3, CCF_RGB24,
+		_convert_yuv420_rgb24_ssse3, _convert_yuv420_rgb24 },
+	{ "yuv420_xrgb32_sse2", TF_SSE2, CCF_XRGB32,
+		_convert_yuv420_xrgb32_sse2, _convert_yuv420_xrgb32 },
+#elif defined(CONVERT_NEON)
+	{ "yuv420_rgb24_neon", TF_NEON, CCF_RGB24,
+		_convert_yuv420_rgb24_neon, _convert_yuv420_rgb24 },
+# if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	{ "yuv420_xrgb32_neon", TF_NEON, CCF_XRGB32,
+		_convert_yuv420_xrgb32_neon, _convert_yuv420_xrgb32 },
+# endif
+#endif
+};
+
+static const TestReverse _test_reverses[] =
+{
+	{ "reverse_rgb24", TF_NONE, CCF_RGB24, _convert_reverse_rgb24 },
+	{ "reverse_xrgb32", TF_NONE, CCF_XRGB32, _convert_reverse_xrgb32 },
+#if defined(CONVERT_X86)
+	{ "reverse_rgb24_ssse3", TF_SSSE3, CCF_RGB24,
+		_convert_reverse_rgb24_ssse3 },
+	{ "reverse_xrgb32_sse2", TF_SSE2, CCF_XRGB32,
+		_convert_reverse_xrgb32_sse2 },
+#elif defined(CONVERT_NEON)
+	{ "reverse_rgb24_neon", TF_NEON, CCF_RGB24,
+		_convert_reverse_rgb24_neon },
+	{ "reverse_xrgb32_neon", TF_NEON, CCF_XRGB32,
+		_convert_reverse_xrgb32_neon },
+#endif
+};
+
+static const TestBlend _test_blends[] =
+{
+	{ "blend", TF_NONE, _convert_blend },
+#if defined(CONVERT_X86)
+	{ "blend_sse2", TF_SSE2, _convert_blend_sse2 },
+#elif defined(CONVERT_NEON)
+	{ "blend_neon", TF_NEON, _convert_blend_neon },
+#endif
+};
+
+static const TestDecimate _test_decimates[] =
+{
+	{ "decimate2_rgb24", TF_NONE, CCF_RGB24, 2, _convert_decimate2_rgb24 },
+	{ "decimate2_xrgb32", TF_NONE, CCF_XRGB32, 2,
+		_convert_decimate2_xrgb32 },
+	{ "decimate4_rgb24", TF_NONE, CCF_RGB24, 4, _convert_decimate4_rgb24 },
+	{ "decimate4_xrgb32", TF_NONE, CCF_XRGB32, 4,
+		_convert_decimate4_xrgb32 },
+#if defined(CONVERT_X86)
+	{ "decimate2_rgb24_ssse3", TF_SSSE3, CCF_RGB24, 2,
+		_convert_decimate2_rgb24_ssse3 },
+	{ "decimate2_xrgb32_sse2", TF_SSE2, CCF_XRGB32, 2,
+		_convert_decimate2_xrgb32_sse2 },
+	{ "decimate4_xrgb32_sse2", TF_SSE2, CCF_XRGB32, 4,
+		_convert_decimate4_xrgb32_sse2 },
+#elif defined(CONVERT_NEON)
+	{ "decimate2_rgb24_neon", TF_NEON, CCF_RGB24, 2,
+		_convert_decimate2_rgb24_neon },
+	{ "decimate2_xrgb32_neon", TF_NEON, CCF_XRGB32, 2,
+		_convert_decimate2_xrgb32_neon },
+	{ "decimate4_rgb24_neon", TF_NEON, CCF_RGB24, 4,
+		_convert_decimate4_rgb24_neon },
+	{ "decimate4_xrgb32_neon", TF_NEON, CCF_XRGB32, 4,
+		_convert_decimate4_xrgb32_neon },
+#endif
+};
+
+static const TestFrame _test_frames[] =
+{
+	{ CAMERACONVERT_FOURCC('Y', 'U', 'Y', 'V'), 2 },
+	{ CAMERACONVERT_FOURCC('U', 'Y', 'V', 'Y'), 2 },
+	{ CAMERACONVERT_FOURCC('G', 'R', 'E', 'Y'), 1 },
+	{ CAMERACONVERT_FOURCC('R', 'G', 'B', '3'), 3 },
+	{ CAMERACONVERT_FOURCC('B', 'G', 'R', '3'), 3 },
+	{ CAMERACONVERT_FOURCC('N', 'V', '1', '2'), 1 },
+	{ CAMERACONVERT_FOURCC('N', 'V', '2', '1'), 1 },
+	{ CAMERACONVERT_FOURCC('Y', 'U', '1', '2'), 1 },
+	{ CAMERACONVERT_FOURCC('Y', 'V', '1', '2'), 1 }
+};
+
+static const TestScale _test_scales[] =
+{
+	/* decimated */
+	{ 64, 48, 32, 24 },
+	{ 64, 48, 16, 12 },
+	{ 1280, 960, 640, 480 },
+	/* downscaled */
+	{ 37, 21, 13, 7 },
+	{ 100, 80, 33, 27 },
+	{ 3, 3, 1, 1 },
+	/* upscaled */
+	{ 33, 27, 100, 80 },
+	{ 1, 1, 5, 3 },
+	{ 320, 240, 400, 480 },
+	/* unscaled */
+	{ 41, 29, 41, 29 }
+};
+
+
+/* prototypes */
+static int _test_supports(TestFeature feature);
+
+static int _test_row(CameraConvert * convert, TestRow const * test);
+static int _test_planar(CameraConvert * convert, TestPlanar const * test);
+static int _test_reverse(TestReverse const * test);
+static int _test_blend(TestBlend const * test);
+static int _test_decimate(TestDecimate const * test);
+static int _test_frame(CameraConvert * convert, TestFrame const * test,
+		unsigned int width, unsigned int height);
+static int _test_scale(CameraConvert * convert, TestScale const * test,
+		CameraConvertFormat format, CameraConvertInterp interp,
+		CameraConvertFlip flip);
+static int _test_flip(CameraConvert * convert, CameraConvertFormat format,
+		CameraConvertFlip flip, unsigned int width,
+		unsigned int height);
+
+/* helpers */
+static int _test_canary(char const * name, unsigned char const * data,
+		size_t size);
+static int _test_compare(char const * name, unsigned int x,
+		uint8_t const value[3], uint8_t const expected[3],
+		int tolerance);
+static int _test_pixel(CameraConvertFormat format, unsigned char const * data,
+		unsigned int x, uint8_t rgb[3]);
+static void _test_random(unsigned char * data, size_t size);
+static void _test_reference(int amp, uint8_t y, uint8_t u, uint8_t v,
+		uint8_t rgb[3]);
+static void _test_reference_packed(int amp, CameraConvertKernel kernel,
+		unsigned char const * src, unsigned int x, uint8_t rgb[3]);
+
+
+/* functions */
+/* test_supports */
+static int _test_supports(TestFeature feature)
+{
+	switch(feature)
+	{
+		case TF_NONE:
+			return 1;
+#if defined(CONVERT_X86)
+		case TF_SSE2:
+			return __builtin_cpu_supports("sse2");
+		case TF_SSSE3:
+			return __builtin_cpu_supports("ssse3");
+		case TF_AVX2:
+			return __builtin_cpu_supports("avx2");
+#elif defined(CONVERT_NEON)
+		case TF_NEON:
+			return 1;
+#endif
+		default:
+			return 0;
+	}
+}
+
+
+/* test_row */
+static int _test_row_exhaustive(CameraConvert * convert,
+		TestRow const * test);
+static int _test_row_widths(CameraConvert * convert, TestRow const * test);
+
+static int _test_row(CameraConvert * convert, TestRow const * test)
+{
+	if(test->kernel != CCK_RGB24 && test->kernel != CCK_BGR24
+			&& _test_row_exhaustive(convert, test) != 0)
+		return -1;
+	return _test_row_widths(convert, test);
+}
+
+static int _test_row_exhaustive(CameraConvert * convert,
+		TestRow const * test)
+{
+	unsigned char src[TEST_WIDTH * 2 + TEST_SLACK];
+	unsigned char dst[TEST_WIDTH * 4 + TEST_SLACK];
+	unsigned char scalar[TEST_WIDTH * 4 + TEST_SLACK];
+	unsigned int uv = (test->kernel == CCK_GREY) ? 65535 : 0;
+	unsigned int x;
+	uint8_t value[3];
+	uint8_t expected[3];
+
+	/* every combination of luminance and chrominance */
+	for(; uv < 65536; uv++)
+	{
+		for(x = 0; x < TEST_WIDTH; x += 2)
+			if(test->kernel == CCK_GREY)
+			{
+				src[x] = x;
+				src[x + 1] = x + 1;
+			}
+			else if(test->kernel == CCK_YUYV)
+			{
+				src[x * 2] = x;
+				src[x * 2 + 1] = uv >> 8;
+				src[x * 2 + 2] = x + 1;
+				src[x * 2 + 3] = uv & 0xff;
+			}
+			else
+			{
+				src[x * 2] = uv >> 8;
+				src[x * 2 + 1] = x;
+				src[x * 2 + 2] = uv & 0xff;
+				src[x * 2 + 3] = x + 1;
+			}
+		test->row(convert, src, dst, TEST_WIDTH);
+		test->scalar(convert, src, scalar, TEST_WIDTH);
+		for(x = 0; x < TEST_WIDTH; x++)
+		{
+			_test_reference_packed(convert->amp, test->kernel, src,
+					x, expected);
+			if(_test_pixel(test->format, dst, x, value) != 0
+					|| _test_compare(test->name, x, value,
+						expected, 1) != 0)
+				return -1;
+			_test_pixel(test->format, scalar, x, expected);
+			if(_test_compare(test->name, x, value, expected, 1)
+					!= 0)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+static int _test_row_widths(CameraConvert * convert, TestRow const * test)
+{
+	unsigned char src[TEST_WIDTHS * 3 + TEST_SLACK];
+	unsigned char dst[TEST_WIDTHS * 4 + TEST_SLACK];
+	unsigned char scalar[TEST_WIDTHS * 4 + TEST_SLACK];
+	size_t bpp = (test->format == CCF_XRGB32) ? 4 : 3;
+	int tolerance = (test->kernel == CCK_RGB24
+			|| test->kernel == CCK_BGR24) ? 0 : 1;
+	unsigned int width;
+	unsigned int cnt;
+	unsigned int x;
+	uint8_t value[3];
+	uint8_t expected[3];
+
+	for(width = 0; width < TEST_WIDTHS; width++)
+	{
+		_test_random(src, sizeof(src));
+		memset(dst, TEST_CANARY, sizeof(dst));
+		memset(scalar, TEST_CANARY, sizeof(scalar));
+		test->row(convert, src, dst, width);
+		test->scalar(convert, src, scalar, width);
+		/* the last pixel of an odd row has no chrominance */
+		cnt = (test->kernel == CCK_YUYV || test->kernel == CCK_UYVY)
+			? width & ~1 : width;
+		for(x = 0; x < cnt; x++)
+		{
+			_test_reference_packed(convert->amp, test->kernel, src,
+					x, expected);
+			if(_test_pixel(test->format, dst, x, value) != 0
+					|| _test_compare(test->name, x, value,
+						expected, tolerance) != 0)
+				return -1;
+			_test_pixel(test->format, scalar, x, expected);
+			if(_test_compare(test->name, x, value, expected,
+						tolerance) != 0)
+				return -1;
+		}
+		if(_test_canary(test->name, &dst[bpp * cnt],
+					sizeof(dst) - bpp * cnt) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+
+/* test_planar */
+static int _test_planar_exhaustive(CameraConvert * convert,
+		TestPlanar const * test, size_t step);
+static int _test_planar_widths(CameraConvert * convert,
+		TestPlanar const * test, size_t step);
+
+static int _test_planar(CameraConvert * convert, TestPlanar const * test)
+{
+	size_t step;
+
+	/* in planes of their own, then interleaved */
+	for(step = 1; step <= 2; step++)
+		if(_test_planar_exhaustive(convert, test, step) != 0
+				|| _test_planar_widths(convert, test, step)
+				!= 0)
+			return -1;
+	return 0;
+}
+
+static int _test_planar_exhaustive(CameraConvert * convert,
+		TestPlanar const * test, size_t step)
+{
+	unsigned char luma[TEST_WIDTH + TEST_SLACK];
+	unsigned char chroma[TEST_WIDTH * 2 + TEST_SLACK];
+	unsigned char * u = chroma;
+	unsigned char * v = (step == 1) ? &chroma[TEST_WIDTH] : &chroma[1];
+	unsigned char dst[TEST_WIDTH * 4 + TEST_SLACK];
+	unsigned char scalar[TEST_WIDTH * 4 + TEST_SLACK];
+	unsigned int uv;
+	unsigned int x;
+	uint8_t value[3];
+	uint8_t expected[3];
+
+	for(x = 0; x < TEST_WIDTH; x++)
+		luma[x] = x;
+	for(uv = 0; uv < 65536; uv++)
+	{
+		for(x = 0; x < TEST_WIDTH / 2; x++)
+		{
+			u[x * step] = uv >> 8;
+			v[x * step] = uv & 0xff;
+		}
+		test->planar(convert, luma, u, v, step, dst, TEST_WIDTH);
+		test->scalar(convert, luma, u, v, step, scalar, TEST_WIDTH);
+		for(x = 0; x < TEST_WIDTH; x++)
+		{
+			_test_reference(convert->amp, x, uv >> 8, uv & 0xff,
+					expected);
+			if(_test_pixel(test->format, dst, x, value) != 0
+					|| _test_compare(test->name, x, value,
+						expected, 1) != 0)
+				return -1;
+			_test_pixel(test->format, scalar, x, expected);
+			if(_test_compare(test->name, x, value, expected, 1)
+					!= 0)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+static int _test_planar_widths(CameraConvert * convert,
+		TestPlanar const * test, size_t step)
+{
+	unsigned char luma[TEST_WIDTHS + TEST_SLACK];
+	unsigned char chroma[TEST_WIDTHS * 2 + TEST_SLACK];
+	unsigned char * u = chroma;
+	unsigned char * v = (step == 1) ? &chroma[TEST_WIDTHS] : &chroma[1];
+	unsigned char dst[TEST_WIDTHS * 4 + TEST_SLACK];
+	unsigned char scalar[TEST_WIDTHS * 4 + TEST_SLACK];
+	size_t bpp = (test->format == CCF_XRGB32) ? 4 : 3;
+	unsigned int width;
+	unsigned int x;
+	uint8_t value[3];
+	uint8_t expected[3];
+
+	for(width = 0; width < TEST_WIDTHS; width++)
+	{
+		_test_random(luma, sizeof(luma));
+		_test_random(chroma, sizeof(chroma));
+		memset(dst, TEST_CANARY, sizeof(dst));
+		memset(scalar, TEST_CANARY, sizeof(scalar));
+		test->planar(convert, luma, u, v, step, dst, width);
+		test->scalar(convert, luma, u, v, step, scalar, width);
+		for(x = 0; x < width; x++)
+		{
+			_test_reference(convert->amp, luma[x], u[x / 2 * step],
+					v[x / 2 * step], expected);
+			if(_test_pixel(test->format, dst, x, value) != 0
+					|| _test_compare(test->name, x, value,
+						expected, 1) != 0)
+				return -1;
+			_test_pixel(test->format, scalar, x, expected);
+			if(_test_compare(test->name, x, value, expected, 1)
+					!= 0)
+				return -1;
+		}
+		if(_test_canary(test->name, &dst[bpp * width],
+					sizeof(dst) - bpp * width) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+
+/* test_reverse */
+static int _test_reverse(TestReverse const * test)
+{
+	unsigned char a[TEST_WIDTHS * 4 + TEST_SLACK];
+	unsigned char b[TEST_WIDTHS * 4 + TEST_SLACK];
+	unsigned char ea[TEST_WIDTHS * 4 + TEST_SLACK];
+	unsigned char eb[TEST_WIDTHS * 4 + TEST_SLACK];
+	size_t bpp = (test->format == CCF_XRGB32) ? 4 : 3;
+	unsigned int width;
+	unsigned int x;
+
+	for(width = 0; width < TEST_WIDTHS; width++)
+	{
+		/* exchanging two rows */
+		_test_random(a, sizeof(a));
+		_test_random(b, sizeof(b));
+		memcpy(ea, a, sizeof(ea));
+		memcpy(eb, b, sizeof(eb));
+		for(x = 0; x < width; x++)
+		{
+			memcpy(&ea[bpp * x], &b[bpp * (width - x - 1)], bpp);
+			memcpy(&eb[bpp * (width - x - 1)], &a[bpp * x], bpp);
+		}
+		test->reverse(a, b, width);
+		if(memcmp(a, ea, sizeof(a)) != 0
+				|| memcmp(b, eb, sizeof(b)) != 0)
+		{
+			printf("%s: %s: Rows not exchanged (width %u)\n",
+					PROGNAME, test->name, width);
+			return -1;
+		}
+		/* reversing a single row */
+		_test_random(a, sizeof(a));
+		memcpy(ea, a, sizeof(ea));
+		for(x = 0; x < width; x++)
+			memcpy(&ea[bpp * x], &a[bpp * (width - x - 1)], bpp);
+		test->reverse(a, a, width);
+		if(memcmp(a, ea, sizeof(a)) != 0)
+		{
+			printf("%s: %s: Row not reversed (width %u)\n",
+					PROGNAME, test->name, width);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+/* test_blend */
+static int _test_blend(TestBlend const * test)
+{
+	unsigned char top[TEST_WIDTHS * 4];
+	unsigned char bottom[TEST_WIDTHS * 4];
+	unsigned char dst[TEST_WIDTHS * 4 + TEST_SLACK];
+	unsigned int weight;
+	unsigned int expected;
+	size_t size;
+	size_t i;
+
+	for(size = 0; size <= sizeof(top); size++)
+		for(weight = 0; weight < 256; weight++)
+		{
+			_test_random(top, sizeof(top));
+			_test_random(bottom, sizeof(bottom));
+			memset(dst, TEST_CANARY, sizeof(dst));
+			test->blend(top, bottom, weight, dst, size);
+			for(i = 0; i < size; i++)
+			{
+				expected = (top[i] * (256 - weight)
+						+ bottom[i] * weight + 128)
+					>> 8;
+				if(dst[i] == expected)
+					continue;
+				printf("%s: %s: %u instead of %u (size %lu,"
+						" weight %u)\n", PROGNAME,
+						test->name, dst[i], expected,
+						(unsigned long)size, weight);
+				return -1;
+			}
+			if(_test_canary(test->name, &dst[size],
+						sizeof(dst) - size) != 0)
+				return -1;
+		}
+	return 0;
+}
+
+
+/* test_decimate */
+static int _test_decimate(TestDecimate const * test)
+{
+	unsigned char data[4][TEST_WIDTHS * 4 * 4 + TEST_SLACK];
+	unsigned char const * rows[4] = { data[0], data[1], data[2], data[3] };
+	unsigned char dst[TEST_WIDTHS * 4 + TEST_SLACK];
+	size_t bpp = (test->format == CCF_XRGB32) ? 4 : 3;
+	unsigned int n = test->factor * test->factor;
+	unsigned int width;
+	unsigned int expected;
+	unsigned int x;
+	unsigned int i;
+	unsigned int j;
+	size_t c;
+
+	for(width = 0; width < TEST_WIDTHS; width++)
+	{
+		_test_random(&data[0][0], sizeof(data));
+		memset(dst, TEST_CANARY, sizeof(dst));
+		test->decimate(rows, dst, width);
+		for(x = 0; x < width; x++)
+			for(c = 0; c < bpp; c++)
+			{
+				for(expected = 0, i = 0; i < test->factor; i++)
+					for(j = 0; j < test->factor; j++)
+						expected += rows[i][bpp
+							* (test->factor * x + j)
+							+ c];
+				expected = (expected + n / 2) / n;
+				if(dst[bpp * x + c] == expected)
+					continue;
+				printf("%s: %s: %u instead of %u (width %u,"
+						" pixel %u)\n", PROGNAME,
+						test->name, dst[bpp * x + c],
+						expected, width, x);
+				return -1;
+			}
+		if(_test_canary(test->name, &dst[bpp * width],
+					sizeof(dst) - bpp * width) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+
+/* test_frame */
+/* the last row of every plane may be as short as its pixels */
+static int _test_frame(CameraConvert * convert, TestFrame const * test,
+		unsigned int width, unsigned int height)
+{
+	int ret = 0;
+	size_t stride = test->bpp * width + TEST_SLACK;
+	size_t size = stride * height * 2;
+	size_t dst_stride = 3 * width;
+	unsigned char * src;
+	unsigned char * expected;
+	unsigned char * dst;
+	CameraConvertPlane planes[CAMERACONVERT_PLANES_MAX];
+	unsigned int cnt;
+	unsigned int i;
+
+	src = malloc(size);
+	expected = malloc(dst_stride * height);
+	dst = malloc(dst_stride * height);
+	if(src == NULL || expected == NULL || dst == NULL)
+	{
+		free(src);
+		free(expected);
+		free(dst);
+		printf("%s: %s\n", PROGNAME, strerror(errno));
+		return -1;
+	}
+	_test_random(src, size);
+	memset(expected, TEST_CANARY, dst_stride * height);
+	cnt = cameraconvert_planes(test->fourcc, src, size, stride, width,
+			height, planes);
+	if(cameraconvert_frame(convert, test->fourcc, CCF_RGB24, planes,
+				width, height, expected, dst_stride) != 0)
+		ret = -1;
+	/* the chrominance is interleaved with two planes */
+	planes[0].size = stride * (height - 1) + test->bpp * width;
+	for(i = 1; i < cnt; i++)
+		planes[i].size = planes[i].stride * ((height - 1) / 2)
+			+ (width + 1) / 2 * ((cnt == 2) ? 2 : 1);
+	memset(dst, TEST_CANARY, dst_stride * height);
+	if(ret != 0 || cameraconvert_frame(convert, test->fourcc, CCF_RGB24,
+				planes, width, height, dst, dst_stride) != 0
+			|| memcmp(dst, expected, dst_stride * height) != 0)
+	{
+		printf("%s: %.4s %ux%u: Not converted entirely\n", PROGNAME,
+				(char const *)&test->fourcc, width, height);
+		ret = -1;
+	}
+	free(src);
+	free(expected);
+	free(dst);
+	return ret;
+}
+
+
+/* test_scale */
+static double _scale_reference(unsigned char const * src, size_t stride,
+		TestScale const * test, CameraConvertInterp interp,
+		unsigned int x, unsigned int y, size_t c);
+static double _scale_reference_area(unsigned int d, unsigned int dst,
+		unsigned int src, unsigned int s);
+static double _scale_reference_bilinear(unsigned int d, unsigned int dst,
+		unsigned int src, unsigned int * s);
+
+static int _test_scale(CameraConvert * convert, TestScale const * test,
+		CameraConvertFormat format, CameraConvertInterp interp,
+		CameraConvertFlip flip)
+{
+	static char const * interps[CCI_COUNT] = { "nearest", "bilinear",
+		"area" };
+	int ret = 0;
+	size_t stride = (size_t)test->src_width * 3;
+	size_t bpp = (format == CCF_XRGB32) ? 4 : 3;
+	size_t dst_stride = bpp * test->dst_width + TEST_SLACK;
+	unsigned char * src;
+	unsigned char * dst;
+	CameraConvertPlane planes[CAMERACONVERT_PLANES_MAX];
+	double tolerance;
+	double expected;
+	unsigned int x;
+	unsigned int y;
+	size_t c;
+	uint8_t value[3];
+
+	switch(interp)
+	{
+		case CCI_NEAREST:
+			tolerance = 0.0;
+			break;
+		default:
+			tolerance = 1.0;
+			break;
+	}
+	src = malloc(stride * test->src_height);
+	dst = malloc(dst_stride * test->dst_height);
+	if(src == NULL || dst == NULL)
+	{
+		free(src);
+		free(dst);
+		printf("%s: %s\n", PROGNAME, strerror(errno));
+		return -1;
+	}
+	_test_random(src, stride * test->src_height);
+	memset(dst, TEST_CANARY, dst_stride * test->dst_height);
+	cameraconvert_planes(TEST_FOURCC_RGB24, src,
+			stride * test->src_height, stride, test->src_width,
+			test->src_height, planes);
+	if(cameraconvert_frame_scale(convert, TEST_FOURCC_RGB24, format,
+				interp, flip, planes, test->src_width,
+				test->src_height, dst, dst_stride,
+				test->dst_width, test->dst_height) != 0)
+	{
+		free(src);
+		free(dst);
+		printf("%s: Could not scale\n", PROGNAME);
+		return -1;
+	}
+	for(y = 0; ret == 0 && y < test->dst_height; y++)
+		for(x = 0; ret == 0 && x < test->dst_width; x++)
+		{
+			if(_test_pixel(format, &dst[dst_stride * y], x, value)
+					!= 0)
+			{
+				ret = -1;
+				break;
+			}
+			/* the flipped frame is expected in the mirror */
+			for(c = 0; c < 3; c++)
+			{
+				expected = _scale_reference(src, stride, test,
+						interp, (flip & CCFL_HORIZONTAL)
+						? test->dst_width - x - 1 : x,
+						(flip & CCFL_VERTICAL)
+						? test->dst_height - y - 1 : y,
+						c);
+				if(fabs(value[c] - expected) <= tolerance)
+					continue;
+				printf("%s: %ux%u to %ux%u (%s, flip %u):"
+						" %u instead of %.2f at %u,%u\n",
+						PROGNAME, test->src_width,
+						test->src_height,
+						test->dst_width,
+						test->dst_height,
+						interps[interp], flip,
+						value[c], expected, x, y);
+				ret = -1;
+				break;
+			}
+		}
+	for(y = 0; ret == 0 && y < test->dst_height; y++)
+		ret = _test_canary(interps[interp],
+				&dst[dst_stride * y + bpp * test->dst_width],
+				TEST_SLACK);
+	free(src);
+	free(dst);
+	return ret;
+}
+
+static double _scale_reference(unsigned char const * src, size_t stride,
+		TestScale const * test, CameraConvertInterp interp,
+		unsigned int x, unsigned int y, size_t c)
+{
+	double value = 0.0;
+	double wx;
+	double wy;
+	unsigned int sx;
+	unsigned int sy;
+
+	switch(interp)
+	{
+		case CCI_NEAREST:
+			sx = (2 * x + 1) * test->src_width
+				/ (2 * test->dst_width);
+			sy = (2 * y + 1) * test->src_height
+				/ (2 * test->dst_height);
+			return src[stride * sy + 3 * sx + c];
+		case CCI_BILINEAR:
+			wx = _scale_reference_bilinear(x, test->dst_width,
+					test->src_width, &sx);
+			wy = _scale_reference_bilinear(y, test->dst_height,
+					test->src_height, &sy);
+			value = src[stride * sy + 3 * sx + c]
+				* (1.0 - wx) * (1.0 - wy);
+			if(wx > 0.0)
+				value += src[stride * sy + 3 * (sx + 1) + c]
+					* wx * (1.0 - wy);
+			if(wy > 0.0)
+				value += src[stride * (sy + 1) + 3 * sx + c]
+					* (1.0 - wx) * wy;
+			if(wx > 0.0 && wy > 0.0)
+				value += src[stride * (sy + 1) + 3 * (sx + 1)
+					+ c] * wx * wy;
+			return value;
+		case CCI_AREA:
+			for(sy = y * test->src_height / test->dst_height;
+					sy < test->src_height; sy++)
+			{
+				if((wy = _scale_reference_area(y,
+							test->dst_height,
+							test->src_height, sy))
+						== 0.0)
+					break;
+				for(sx = x * test->src_width / test->dst_width;
+						sx < test->src_width; sx++)
+				{
+					if((wx = _scale_reference_area(x,
+								test->dst_width,
+								test->src_width,
+								sx)) == 0.0)
+						break;
+					value += src[stride * sy + 3 * sx + c]
+						* wx * wy;
+				}
+			}
+			return value;
+	}
+	return value;
+}
+
+/* the part of the destination pixel covered by a source pixel */
+static double _scale_reference_area(unsigned int d, unsigned int dst,
+		unsigned int src, unsigned int s)
+{
+	double begin = (double)d * src / dst;
+	double end = (double)(d + 1) * src / dst;
+	double left = MAX(begin, (double)s);
+	double right = MIN(end, (double)(s + 1));
+
+	return (right > left) ? (right - left) / (end - begin) : 0.0;
+}
+
+/* with the centers of the pixels aligned, and weights in steps of 1/256 */
+static double _scale_reference_bilinear(unsigned int d, unsigned int dst,
+		unsigned int src, unsigned int * s)
+{
+	double pos = (d + 0.5) * src / dst - 0.5;
+
+	if(pos < 0.0)
+		pos = 0.0;
+	*s = pos;
+	if(*s + 1 >= src)
+	{
+		*s = src - 1;
+		return 0.0;
+	}
+	return floor((pos - *s) * 256.0) / 256.0;
+}
+
+
+/* test_flip */
+static int _test_flip(CameraConvert * convert, CameraConvertFormat format,
+		CameraConvertFlip flip, unsigned int width,
+		unsigned int height)
+{
+	int ret = 0;
+	size_t bpp = (format == CCF_XRGB32) ? 4 : 3;
+	size_t stride = bpp * width + TEST_SLACK;
+	unsigned char * data;
+	unsigned char * expected;
+	unsigned int x;
+	unsigned int y;
+	unsigned int fx;
+	unsigned int fy;
+
+	data = malloc(stride * height);
+	expected = malloc(stride * height);
+	if(data == NULL || expected == NULL)
+	{
+		free(data);
+		free(expected);
+		printf("%s: %s\n", PROGNAME, strerror(errno));
+		return -1;
+	}
+	_test_random(data, stride * height);
+	memcpy(expected, data, stride * height);
+	for(y = 0; y < height; y++)
+		for(x = 0; x < width; x++)
+		{
+			fx = (flip & CCFL_HORIZONTAL) ? width - x - 1 : x;
+			fy = (flip & CCFL_VERTICAL) ? height - y - 1 : y;
+			memcpy(&expected[stride * y + bpp * x],
+					&data[stride * fy + bpp * fx], bpp);
+		}
+	cameraconvert_flip(convert, format, flip, data, stride, width, height);
+	if(memcmp(data, expected, stride * height) != 0)
+	{
+		printf("%s: %ux%u (flip %u): Not flipped\n", PROGNAME, width,
+				height, flip);
+		ret = -1;
+	}
+	free(data);
+	free(expected);
+	return ret;
+}
+
+
+/* helpers */
+/* test_canary */
+static int _test_canary(char const * name, unsigned char const * data,
+		size_t size)
+{
+	size_t i;
+
+	for(i = 0; i < size; i++)
+		if(data[i] != TEST_CANARY)
+		{
+			printf("%s: %s: Wrote past the end of the row\n",
+					PROGNAME, name);
+			return -1;
+		}
+	return 0;
+}
+
+
+/* test_compare */
+static int _test_compare(char const * name, unsigned int x,
+		uint8_t const value[3], uint8_t const expected[3],
+		int tolerance)
+{
+	size_t c;
+
+	for(c = 0; c < 3; c++)
+		if(abs(value[c] - expected[c]) > tolerance)
+		{
+			printf("%s: %s: %u,%u,%u instead of %u,%u,%u"
+					" (pixel %u)\n", PROGNAME, name,
+					value[0], value[1], value[2],
+					expected[0], expected[1], expected[2],
+					x);
+			return -1;
+		}
+	return 0;
+}
+
+
+/* test_pixel */
+static int _test_pixel(CameraConvertFormat format, unsigned char const * data,
+		unsigned int x, uint8_t rgb[3])
+{
+	uint32_t pixel;
+
+	if(format == CCF_RGB24)
+	{
+		memcpy(rgb, &data[x * 3], 3);
+		return 0;
+	}
+	/* native-endian words */
+	memcpy(&pixel, &data[x * 4], sizeof(pixel));
+	rgb[0] = (pixel >> 16) & 0xff;
+	rgb[1] = (pixel >> 8) & 0xff;
+	rgb[2] = pixel & 0xff;
+	if((pixel >> 24) == 0xff)
+		return 0;
+	printf("%s: Pixel %u not opaque\n", PROGNAME, x);
+	return -1;
+}
+
+
+/* test_random */
+static void _test_random(unsigned char * data, size_t size)
+{
+	size_t i;
+
+	for(i = 0; i < size; i++)
+		data[i] = rand() >> 7;
+}
+
+
+/* test_reference */
+static uint8_t _reference_clamp(double value);
+
+/* the conversion originally done in floating point for every pixel */
+static void _test_reference(int amp, uint8_t y, uint8_t u, uint8_t v,
+		uint8_t rgb[3])
+{
+	rgb[0] = _reference_clamp(amp * (0.004565 * y + 0.000001 * u
+				+ 0.006250 * v - 0.872));
+	rgb[1] = _reference_clamp(amp * (0.004565 * y - 0.001542 * u
+				- 0.003183 * v + 0.531));
+	rgb[2] = _reference_clamp(amp * (0.004565 * y + 0.007935 * u
+				- 1.088));
+}
+
+static uint8_t _reference_clamp(double value)
+{
+	return (value < 0) ? 0 : ((value > 255) ? 255 : value);
+}
+
+
+/* test_reference_packed */
+static void _test_reference_packed(int amp, CameraConvertKernel kernel,
+		unsigned char const * src, unsigned int x, uint8_t rgb[3])
+{
+	unsigned char const * p = &src[x / 2 * 4];
+
+	switch(kernel)
+	{
+		case CCK_YUYV:
+			_test_reference(amp, p[(x % 2) * 2], p[1], p[3], rgb);
+			break;
+		case CCK_UYVY:
+			_test_reference(amp, p[(x % 2) * 2 + 1], p[0], p[2],
+					rgb);
+			break;
+		case CCK_GREY:
+			_test_reference(amp, src[x], 128, 128, rgb);
+			break;
+		case CCK_RGB24:
+			memcpy(rgb, &src[x * 3], 3);
+			break;
+		case CCK_BGR24:
+			rgb[0] = src[x * 3 + 2];
+			rgb[1] = src[x * 3 + 1];
+			rgb[2] = src[x * 3];
+			break;
+		default:
+			break;
+	}
+}
+
+
+/* public */
+/* functions */
+/* main */
+int main(void)
+{
+	int ret = 0;
+	CameraConvert * convert;
+	CameraConvertFormat format;
+	CameraConvertInterp interp;
+	unsigned int flip;
+	unsigned int bands;
+	unsigned int width;
+	unsigned int height;
+	size_t i;
+
+	srand(1);
+	if((convert = cameraconvert_new(255)) == NULL)
+	{
+		error_print(PROGNAME);
+		return 2;
+	}
+	/* the kernels */
+	for(i = 0; i < sizeof(_test_rows) / sizeof(*_test_rows); i++)
+		if(_test_supports(_test_rows[i].feature))
+		{
+			printf("%s: Testing %s\n", PROGNAME,
+					_test_rows[i].name);
+			ret |= _test_row(convert, &_test_rows[i]);
+		}
+	for(i = 0; i < sizeof(_test_planars) / sizeof(*_test_planars); i++)
+		if(_test_supports(_test_planars[i].feature))
+		{
+			printf("%s: Testing %s\n", PROGNAME,
+					_test_planars[i].name);
+			ret |= _test_planar(convert, &_test_planars[i]);
+		}
+	for(i = 0; i < sizeof(_test_reverses) / sizeof(*_test_reverses); i++)
+		if(_test_supports(_test_reverses[i].feature))
+		{
+			printf("%s: Testing %s\n", PROGNAME,
+					_test_reverses[i].name);
+			ret |= _test_reverse(&_test_reverses[i]);
+		}
+	for(i = 0; i < sizeof(_test_blends) / sizeof(*_test_blends); i++)
+		if(_test_supports(_test_blends[i].feature))
+		{
+			printf("%s: Testing %s\n", PROGNAME,
+					_test_blends[i].name);
+			ret |= _test_blend(&_test_blends[i]);
+		}
+	for(i = 0; i < sizeof(_test_decimates) / sizeof(*_test_decimates);
+			i++)
+		if(_test_supports(_test_decimates[i].feature))
+		{
+			printf("%s: Testing %s\n", PROGNAME,
+					_test_decimates[i].name);
+			ret |= _test_decimate(&_test_decimates[i]);
+		}
+	/* the frames, with the kernels selected for this CPU */
+	printf("%s: Testing cameraconvert_frame()\n", PROGNAME);
+	for(i = 0; i < sizeof(_test_frames) / sizeof(*_test_frames); i++)
+		for(width = 1; width < 40; width += 7)
+			for(height = 1; height < 10; height++)
+				ret |= _test_frame(convert, &_test_frames[i],
+						width, height);
+	printf("%s: Testing cameraconvert_flip()\n", PROGNAME);
+	for(format = 0; format < CCF_COUNT; format++)
+		for(flip = 0; flip <= (CCFL_HORIZONTAL | CCFL_VERTICAL); flip++)
+			for(i = 1; i < 40; i += 3)
+				ret |= _test_flip(convert, format, flip, i,
+						i / 2 + 1);
+	printf("%s: Testing cameraconvert_frame_scale()\n", PROGNAME);
+	for(bands = 1; bands <= 4; bands += 3)
+	{
+		if(cameraconvert_set_bands(convert, bands) != 0)
+		{
+			error_print(PROGNAME);
+			ret = -1;
+			break;
+		}
+		for(i = 0; i < sizeof(_test_scales) / sizeof(*_test_scales);
+				i++)
+			for(format = 0; format < CCF_COUNT; format++)
+				for(interp = 0; interp < CCI_COUNT; interp++)
+					for(flip = 0; flip <= (CCFL_HORIZONTAL
+								| CCFL_VERTICAL);
+							flip++)
+						ret |= _test_scale(convert,
+								&_test_scales[i],
+								format, interp,
+								flip);
+	}
+	cameraconvert_delete(convert);
+	return (ret == 0) ? 0 : 2;
+}
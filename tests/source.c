@@ -0,0 +1,409 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Camera */
+/* Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ITS AUTHORS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+#include <stdio.h>
+/* the layout of the recorded sessions is private */
+#include "../src/source.c"
+
+#ifndef PROGNAME
+# define PROGNAME	"source"
+#endif
+
+
+/* private */
+/* constants */
+/* frames compared, or recorded */
+#define TEST_FRAMES	12
+/* between the frames recorded, in microseconds */
+#define TEST_INTERVAL	40000
+
+
+/* variables */
+static char const * _test_patterns[] =
+{
+	"test:32x24",
+	"test:yuyv:64x48@0",
+	"test:nv12:64x48@0",
+	"test:mjpeg:64x48@0"
+};
+
+static char const * _test_invalids[] =
+{
+	"test:rgb",
+	"test:1x1",
+	"test:64x",
+	"test:64x48@",
+	"test:64x48@2000"
+};
+
+
+/* prototypes */
+static int _test_pattern(char const * device);
+static int _test_invalid(char const * device);
+static int _test_session(char const * device);
+
+/* helpers */
+static unsigned char * _test_frames(char const * device, size_t * size,
+		size_t used[TEST_FRAMES]);
+static CameraSource * _test_open(char const * device);
+
+
+/* functions */
+/* test_pattern */
+/* the same frames every time, scrolling over time */
+static int _test_pattern(char const * device)
+{
+	int ret = 0;
+	unsigned char * frames[2];
+	size_t size[2];
+	size_t used[2][TEST_FRAMES];
+	size_t i;
+
+	frames[0] = _test_frames(device, &size[0], used[0]);
+	frames[1] = _test_frames(device, &size[1], used[1]);
+	if(frames[0] == NULL || frames[1] == NULL)
+		ret = -1;
+	else if(memcmp(used[0], used[1], sizeof(used[0])) != 0
+			|| memcmp(frames[0], frames[1], size[0] * TEST_FRAMES)
+			!= 0)
+	{
+		printf("%s: %s: Not deterministic\n", PROGNAME, device);
+		ret = -1;
+	}
+	else
+		for(i = 1; i < TEST_FRAMES; i++)
+			if(used[0][i] == used[0][i - 1]
+					&& memcmp(&frames[0][size[0] * i],
+						&frames[0][size[0] * (i - 1)],
+						used[0][i]) == 0)
+			{
+				printf("%s: %s: Frame %zu not moving\n",
+						PROGNAME, device, i);
+				ret = -1;
+				break;
+			}
+	free(frames[0]);
+	free(frames[1]);
+	return ret;
+}
+
+
+/* test_invalid */
+static int _test_invalid(char const * device)
+{
+	CameraSource * source;
+
+	if((source = camerasource_new(device)) == NULL)
+		return 0;
+	printf("%s: %s: Not rejected\n", PROGNAME, device);
+	camerasource_delete(source);
+	return -1;
+}
+
+
+/* test_session */
+static int _session_record(int fd, char const * device,
+		CameraSourceFormat const * format,
+		unsigned char const * frames, size_t size,
+		size_t const used[TEST_FRAMES]);
+static int _session_play(char const * filename, char const * device,
+		CameraSourceFormat const * format,
+		unsigned char const * frames, size_t size,
+		size_t const used[TEST_FRAMES]);
+static int _session_seek(char const * filename, unsigned long frame,
+		unsigned char const * frames, size_t size,
+		size_t const used[TEST_FRAMES]);
+
+/* record the frames of a test pattern, then play them back */
+static int _test_session(char const * device)
+{
+	int ret = 0;
+	CameraSource * source;
+	CameraSourceFormat format;
+	unsigned char * frames;
+	size_t size;
+	size_t used[TEST_FRAMES];
+	int fd;
+	gchar * filename = NULL;
+	GError * error = NULL;
+	unsigned long frame;
+
+	if((source = _test_open(device)) == NULL)
+		return -1;
+	camerasource_get_format(source, &format);
+	camerasource_delete(source);
+	if((frames = _test_frames(device, &size, used)) == NULL)
+		return -1;
+	if((fd = g_file_open_tmp(PROGNAME "-XXXXXX", &filename, &error)) < 0)
+	{
+		printf("%s: %s\n", PROGNAME, error->message);
+		g_error_free(error);
+		free(frames);
+		return -1;
+	}
+	if(_session_record(fd, device, &format, frames, size, used) != 0
+			|| _session_play(filename, device, &format, frames,
+				size, used) != 0)
+		ret = -1;
+	for(frame = 0; ret == 0 && frame <= TEST_FRAMES; frame += 3)
+		ret = _session_seek(filename, frame, frames, size, used);
+	unlink(filename);
+	g_free(filename);
+	free(frames);
+	return ret;
+}
+
+static int _session_record(int fd, char const * device,
+		CameraSourceFormat const * format,
+		unsigned char const * frames, size_t size,
+		size_t const used[TEST_FRAMES])
+{
+	int ret = 0;
+	CameraSourceFileHeader header;
+	CameraSourceFileEntry entry;
+	uint64_t offset = sizeof(header);
+	size_t i;
+
+	memcpy(header.magic, SOURCE_FILE_MAGIC, sizeof(header.magic));
+	header.fourcc = GUINT32_TO_LE(format->fourcc);
+	header.width = GUINT32_TO_LE(format->width);
+	header.height = GUINT32_TO_LE(format->height);
+	header.stride = GUINT32_TO_LE(format->stride);
+	header.frames = GUINT64_TO_LE(TEST_FRAMES);
+	for(i = 0; i < TEST_FRAMES; i++)
+		offset += used[i];
+	header.index = GUINT64_TO_LE(offset);
+	if(write(fd, &header, sizeof(header)) != sizeof(header))
+		ret = -1;
+	for(i = 0; ret == 0 && i < TEST_FRAMES; i++)
+		if(write(fd, &frames[size * i], used[i]) != (ssize_t)used[i])
+			ret = -1;
+	for(i = 0, offset = sizeof(header); ret == 0 && i < TEST_FRAMES;
+			offset += used[i++])
+	{
+		entry.offset = GUINT64_TO_LE(offset);
+		entry.size = GUINT64_TO_LE(used[i]);
+		entry.timestamp = GUINT64_TO_LE(i * TEST_INTERVAL);
+		if(write(fd, &entry, sizeof(entry)) != sizeof(entry))
+			ret = -1;
+	}
+	if(close(fd) != 0 || ret != 0)
+	{
+		printf("%s: %s: %s\n", PROGNAME, device, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int _session_play(char const * filename, char const * device,
+		CameraSourceFormat const * format,
+		unsigned char const * frames, size_t size,
+		size_t const used[TEST_FRAMES])
+{
+	int ret = 0;
+	CameraSource * source;
+	CameraSourceFormat played;
+	unsigned char * buffer;
+	size_t u;
+	size_t i;
+
+	if((source = _test_open(filename)) == NULL)
+		return -1;
+	camerasource_get_format(source, &played);
+	if(played.fourcc != format->fourcc || played.width != format->width
+			|| played.height != format->height
+			|| played.stride != format->stride
+			|| played.numerator != TEST_INTERVAL
+			|| played.denominator != G_USEC_PER_SEC)
+	{
+		printf("%s: %s: Not played back in the same format\n",
+				PROGNAME, device);
+		camerasource_delete(source);
+		return -1;
+	}
+	if((buffer = malloc(played.size)) == NULL)
+	{
+		printf("%s: %s\n", PROGNAME, strerror(errno));
+		camerasource_delete(source);
+		return -1;
+	}
+	camerasource_set_realtime(source, 0);
+	for(i = 0; ret == 0 && i < TEST_FRAMES; i++)
+		if(camerasource_read(source, buffer, played.size, &u) != 0
+				|| u != used[i]
+				|| memcmp(buffer, &frames[size * i], u) != 0)
+		{
+			printf("%s: %s: Frame %zu not played back\n", PROGNAME,
+					device, i);
+			ret = -1;
+		}
+	if(ret == 0 && camerasource_read(source, buffer, played.size, &u)
+			>= 0)
+	{
+		printf("%s: %s: Played back past the end\n", PROGNAME, device);
+		ret = -1;
+	}
+	free(buffer);
+	camerasource_delete(source);
+	return ret;
+}
+
+static int _session_seek(char const * filename, unsigned long frame,
+		unsigned char const * frames, size_t size,
+		size_t const used[TEST_FRAMES])
+{
+	int ret = 0;
+	gchar * device;
+	CameraSource * source;
+	CameraSourceFormat format;
+	unsigned char * buffer;
+	size_t u;
+	int timeout;
+
+	if((device = g_strdup_printf("%s@%lu", filename, frame)) == NULL)
+		return -1;
+	if(frame >= TEST_FRAMES)
+	{
+		/* past the end */
+		ret = _test_invalid(device);
+		g_free(device);
+		return ret;
+	}
+	if((source = _test_open(device)) == NULL)
+	{
+		g_free(device);
+		return -1;
+	}
+	camerasource_get_format(source, &format);
+	if((buffer = malloc(format.size)) == NULL)
+		ret = -1;
+	/* at the original pace, from the frame requested */
+	else if(camerasource_get_timeout(source) != 0
+			|| camerasource_read(source, buffer, format.size, &u)
+			!= 0
+			|| u != used[frame]
+			|| memcmp(buffer, &frames[size * frame], u) != 0)
+	{
+		printf("%s: %s: Not played back from this frame\n", PROGNAME,
+				device);
+		ret = -1;
+	}
+	else if(frame + 1 < TEST_FRAMES
+			&& ((timeout = camerasource_get_timeout(source)) <= 0
+				|| timeout > TEST_INTERVAL / 1000))
+	{
+		printf("%s: %s: Next frame due in %d ms\n", PROGNAME, device,
+				timeout);
+		ret = -1;
+	}
+	free(buffer);
+	camerasource_delete(source);
+	g_free(device);
+	return ret;
+}
+
+
+/* helpers */
+/* test_frames */
+static unsigned char * _test_frames(char const * device, size_t * size,
+		size_t used[TEST_FRAMES])
+{
+	CameraSource * source;
+	CameraSourceFormat format;
+	unsigned char * ret;
+	size_t i;
+
+	if((source = _test_open(device)) == NULL)
+		return NULL;
+	camerasource_get_format(source, &format);
+	camerasource_set_realtime(source, 0);
+	/* compressed frames leave the end of the buffers alone */
+	if((ret = calloc(TEST_FRAMES, format.size)) == NULL)
+	{
+		printf("%s: %s\n", PROGNAME, strerror(errno));
+		camerasource_delete(source);
+		return NULL;
+	}
+	for(i = 0; i < TEST_FRAMES; i++)
+		if(camerasource_read(source, &ret[format.size * i], format.size,
+					&used[i]) != 0)
+		{
+			printf("%s: %s: %s\n", PROGNAME, device,
+					camerasource_get_error(source));
+			free(ret);
+			camerasource_delete(source);
+			return NULL;
+		}
+	*size = format.size;
+	camerasource_delete(source);
+	return ret;
+}
+
+
+/* test_open */
+static CameraSource * _test_open(char const * device)
+{
+	CameraSource * source;
+
+	if(camerasource_probe(device) == 0)
+	{
+		printf("%s: %s: Not a source\n", PROGNAME, device);
+		return NULL;
+	}
+	if((source = camerasource_new(device)) == NULL)
+		error_print(PROGNAME);
+	return source;
+}
+
+
+/* public */
+/* functions */
+/* main */
+int main(void)
+{
+	int ret = 0;
+	size_t i;
+
+	for(i = 0; i < sizeof(_test_patterns) / sizeof(*_test_patterns); i++)
+	{
+		printf("%s: Testing %s\n", PROGNAME, _test_patterns[i]);
+		ret |= _test_pattern(_test_patterns[i]);
+	}
+	for(i = 0; i < sizeof(_test_invalids) / sizeof(*_test_invalids); i++)
+	{
+		printf("%s: Testing %s\n", PROGNAME, _test_invalids[i]);
+		ret |= _test_invalid(_test_invalids[i]);
+	}
+	/* the recorded sessions */
+	for(i = 0; i < sizeof(_test_patterns) / sizeof(*_test_patterns); i++)
+	{
+		printf("%s: Testing a recording of %s\n", PROGNAME,
+				_test_patterns[i]);
+		ret |= _test_session(_test_patterns[i]);
+	}
+	return (ret == 0) ? 0 : 2;
+}